@@ -0,0 +1,693 @@
+#ifndef ASYNC_SERVER_H
+#define ASYNC_SERVER_H
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "BinaryProtocol.h"
+
+#ifdef __linux__
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Event driven front end multiplexing many connections on one epoll loop.
+ *
+ * The network thread only reads, parses and writes; requests that need the solver
+ * become jobs executed by a set of worker threads, so a long search never holds a
+ * network thread and idle keep-alive connections cost a file descriptor and a few
+ * bytes instead of a thread.
+ *
+ * Fairness: every connection has its own FIFO of jobs and workers serve the
+ *   connections with pending jobs in round robin, so one client pipelining
+ *   thousands of requests cannot starve the others.
+ * Serial routes: handlers that must run one at a time (e.g. around a shared game
+ *   state) go to a FIFO served by a thread of their own, so they neither hold the
+ *   solver workers while waiting for each other nor wait behind other jobs.
+ * Backpressure: a connection stops being read while it has max_inflight jobs
+ *   pending, and every connection stops being read while the whole queue holds
+ *   max_queued jobs. Unread data stays in the kernel buffers and TCP flow
+ *   control slows the clients down.
+ *
+ * Two protocols are served, chosen per listener: the BinaryProtocol frames, and a
+ * minimal HTTP/1.1 (Content-Length bodies, keep-alive, pipelining) for fixed routes.
+ * Responses are always sent in request order. Linux only.
+ */
+class AsyncServer {
+ public:
+  enum Protocol {HTTP, BINARY};
+
+  // Where an HTTP route runs
+  enum Dispatch {
+    INLINE, // on the network thread, only for cheap handlers
+    WORKER, // on the solver workers
+    SERIAL  // on the serial thread, one request at a time in arrival order
+  };
+
+  struct Options {
+    size_t workers = 1;              // solver worker threads
+    size_t max_inflight = 64;        // pending jobs per connection before pausing its reads
+    size_t max_queued = 4096;        // pending jobs in total before pausing all reads
+    size_t max_connections = 65536;  // extra connections are closed right after accept
+    size_t max_request_size = 64 * 1024;
+    int idle_timeout_seconds = 300;  // idle connections without pending job are closed
+  };
+
+  struct HttpResponse {
+    int status = 200;
+    std::string content_type = "application/json";
+    std::string body;
+  };
+
+  // Answer an HTTP request body
+  using HttpHandler = std::function<HttpResponse(const char *body, size_t size)>;
+  // Compute the Position::WIDTH scores of a position, Solver::analyze semantics
+  using BinaryHandler = std::function<void(const Position &P, bool weak, int *scores)>;
+
+  explicit AsyncServer(Options options) : options(options) {}
+
+  ~AsyncServer() {
+    stop();
+#ifdef __linux__
+    for(auto &l : listeners) close(l.fd);
+    if(epoll_fd >= 0) close(epoll_fd);
+    if(wake_fd >= 0) close(wake_fd);
+#endif
+  }
+
+  /**
+   * Register an HTTP route.
+   * @param dispatch: thread running the handler.
+   */
+  void route(const std::string &method, const std::string &path, HttpHandler handler, Dispatch dispatch = WORKER) {
+    routes[method + ' ' + path] = Route{handler, dispatch};
+  }
+
+  /**
+   * Parse a TCP port number.
+   * @return false if text is not a number between 1 and 65535.
+   */
+  static bool parsePort(const std::string &text, uint16_t &port) {
+    char *end;
+    errno = 0;
+    const long value = strtol(text.c_str(), &end, 10);
+    if(text.empty() || *end || errno || value < 1 || value > 65535) return false;
+    port = uint16_t(value);
+    return true;
+  }
+
+  void setBinaryHandler(BinaryHandler handler, int invalid_score) {
+    binary_handler = handler;
+    binary_invalid_score = invalid_score;
+  }
+
+  /**
+   * Add a listener, must be called before run().
+   * @param address: a TCP port ("8081", bound on all interfaces) or a Unix domain socket ("unix:/path").
+   * @return false if the address is not a valid port or cannot be bound, errno tells why.
+   */
+  bool listen(const std::string &address, Protocol protocol) {
+#ifdef __linux__
+    int fd = bindAddress(address);
+    if(fd < 0) return false;
+    listeners.push_back(Listener{fd, protocol});
+    return true;
+#else
+    (void)address;
+    (void)protocol;
+    return false;
+#endif
+  }
+
+  /**
+   * Start the workers and run the event loop until stop() is called.
+   */
+  void run() {
+#ifdef __linux__
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    addToEpoll(wake_fd, EPOLLIN);
+    for(auto &l : listeners) addToEpoll(l.fd, EPOLLIN);
+
+    std::vector<std::thread> workers;
+    for(size_t i = 0; i < std::max<size_t>(1, options.workers); i++) workers.emplace_back(&AsyncServer::work, this);
+    workers.emplace_back(&AsyncServer::serialWork, this);
+
+    epoll_event events[256];
+    auto last_sweep = std::chrono::steady_clock::now();
+    while(!stopping) {
+      int n = epoll_wait(epoll_fd, events, 256, 1000);
+      for(int i = 0; i < n; i++) {
+        int fd = events[i].data.fd;
+        if(fd == wake_fd) {
+          uint64_t count;
+          while(read(wake_fd, &count, sizeof(count)) > 0);
+          processCompletions();
+          continue;
+        }
+        const Listener *listener = findListener(fd);
+        if(listener) {
+          acceptAll(*listener);
+          continue;
+        }
+        auto it = connections.find(fd);
+        if(it == connections.end()) continue;
+        std::shared_ptr<Connection> conn = it->second;
+        if(events[i].events & (EPOLLERR | EPOLLHUP)) closeConnection(conn);
+        else {
+          if(events[i].events & EPOLLIN) readInput(conn);
+          if(!conn->closed && (events[i].events & EPOLLOUT)) flush(conn);
+        }
+      }
+      auto now = std::chrono::steady_clock::now();
+      if(now - last_sweep >= std::chrono::seconds(1)) {
+        last_sweep = now;
+        closeIdle(now);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      queue_stopping = true;
+    }
+    queue_ready.notify_all();
+    serial_ready.notify_all();
+    for(auto &w : workers) w.join();
+    for(auto &c : connections) close(c.first);
+    connections.clear();
+#endif
+  }
+
+  void stop() {
+    stopping = true;
+#ifdef __linux__
+    if(wake_fd >= 0) {
+      uint64_t one = 1;
+      if(write(wake_fd, &one, sizeof(one)) < 0) {}
+    }
+#endif
+  }
+
+  // Number of open client connections
+  size_t getConnections() const {
+    return connection_count.load(std::memory_order_relaxed);
+  }
+
+  // Number of jobs waiting for a worker
+  size_t getQueued() const {
+    return queued.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Route {
+    HttpHandler handler;
+    Dispatch dispatch;
+  };
+
+  struct Listener {
+    int fd;
+    Protocol protocol;
+  };
+
+  struct Connection;
+
+  struct Job {
+    std::shared_ptr<Connection> conn;
+    uint64_t seq;                // position of the request on its connection
+    const Route *route;          // HTTP only
+    std::string payload;         // HTTP body or binary request payload
+    bool keep_alive;             // HTTP only
+  };
+
+  struct Connection {
+    int fd;
+    Protocol protocol;
+    std::string in;              // received bytes not yet parsed
+    std::string out;             // bytes ready to be sent
+    std::map<uint64_t, std::string> done; // responses waiting for earlier ones
+    uint64_t next_seq = 0;       // seq of the next parsed request
+    uint64_t send_seq = 0;       // seq of the next response to send
+    size_t inflight = 0;         // jobs not completed yet
+    bool reading = true;         // EPOLLIN registered
+    bool writing = false;        // EPOLLOUT registered
+    bool close_after_write = false;
+    bool closed = false;
+    std::chrono::steady_clock::time_point last_active;
+
+    // protected by the queue mutex
+    std::deque<Job> pending;
+    bool scheduled = false;
+  };
+
+  Options options;
+  std::unordered_map<std::string, Route> routes;
+  BinaryHandler binary_handler;
+  int binary_invalid_score = 0;
+
+  std::vector<Listener> listeners;
+  std::unordered_map<int, std::shared_ptr<Connection>> connections; // network thread only
+  int epoll_fd = -1;
+  int wake_fd = -1;
+  std::atomic<bool> stopping{false};
+  std::atomic<size_t> connection_count{0};
+
+  // fair job queue: connections with pending jobs, served in round robin
+  std::mutex queue_mutex;
+  std::condition_variable queue_ready;
+  std::deque<std::shared_ptr<Connection>> ready_connections;
+  std::atomic<size_t> queued{0};
+  bool queue_stopping = false;
+  std::condition_variable serial_ready;
+  std::deque<Job> serial_jobs;     // jobs of SERIAL routes, in arrival order
+  bool paused = false;             // reads paused because the queue is full, network thread only
+
+  // responses computed by the workers, handed back to the network thread
+  std::mutex completion_mutex;
+  std::vector<std::pair<Job, std::string>> completions;
+
+#ifdef __linux__
+  static int bindAddress(const std::string &address) {
+    int fd;
+    if(address.compare(0, 5, "unix:") == 0) {
+      sockaddr_un addr{};
+      addr.sun_family = AF_UNIX;
+      std::string path = address.substr(5);
+      if(path.size() >= sizeof(addr.sun_path)) return -1;
+      strcpy(addr.sun_path, path.c_str());
+      unlink(path.c_str());
+      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if(fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) return closeFailed(fd);
+    } else {
+      sockaddr_in addr{};
+      addr.sin_family = AF_INET;
+      addr.sin_addr.s_addr = htonl(INADDR_ANY);
+      uint16_t port;
+      if(!parsePort(address, port)) {
+        errno = EINVAL;
+        return -1;
+      }
+      addr.sin_port = htons(port);
+      fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      int one = 1;
+      if(fd >= 0) setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+      if(fd < 0 || bind(fd, (sockaddr *)&addr, sizeof(addr)) < 0) return closeFailed(fd);
+    }
+    if(::listen(fd, SOMAXCONN) < 0) return closeFailed(fd);
+    return fd;
+  }
+
+  static int closeFailed(int fd) {
+    const int error = errno; // reported by the caller
+    if(fd >= 0) close(fd);
+    errno = error;
+    return -1;
+  }
+
+  void addToEpoll(int fd, uint32_t events) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+  }
+
+  void updateEpoll(Connection &conn) {
+    epoll_event ev{};
+    ev.events = (conn.reading ? uint32_t(EPOLLIN) : 0u) | (conn.writing ? uint32_t(EPOLLOUT) : 0u);
+    ev.data.fd = conn.fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+  }
+
+  const Listener *findListener(int fd) const {
+    for(auto &l : listeners)
+      if(l.fd == fd) return &l;
+    return nullptr;
+  }
+
+  void acceptAll(const Listener &listener) {
+    for(;;) {
+      int fd = accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if(fd < 0) return;
+      if(connections.size() >= options.max_connections) {
+        close(fd);
+        continue;
+      }
+      int one = 1;
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); // fails harmlessly on Unix sockets
+      auto conn = std::make_shared<Connection>();
+      conn->fd = fd;
+      conn->protocol = listener.protocol;
+      conn->last_active = std::chrono::steady_clock::now();
+      conn->reading = !paused;
+      connections[fd] = conn;
+      connection_count.store(connections.size(), std::memory_order_relaxed);
+      addToEpoll(fd, conn->reading ? uint32_t(EPOLLIN) : 0u);
+    }
+  }
+
+  void closeConnection(const std::shared_ptr<Connection> &conn) {
+    if(conn->closed) return;
+    conn->closed = true;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    connections.erase(conn->fd);
+    connection_count.store(connections.size(), std::memory_order_relaxed);
+  }
+
+  void closeIdle(std::chrono::steady_clock::time_point now) {
+    std::vector<std::shared_ptr<Connection>> idle;
+    for(auto &c : connections)
+      if(c.second->inflight == 0 && now - c.second->last_active > std::chrono::seconds(options.idle_timeout_seconds))
+        idle.push_back(c.second);
+    for(auto &c : idle) closeConnection(c);
+  }
+
+  // Unparsed bytes kept per connection: one request of maximal header and body size
+  size_t maxBuffered() const {
+    return 2 * options.max_request_size;
+  }
+
+  void readInput(const std::shared_ptr<Connection> &conn) {
+    char buffer[16 * 1024];
+    for(;;) {
+      ssize_t n = read(conn->fd, buffer, sizeof(buffer));
+      if(n > 0) {
+        conn->in.append(buffer, n);
+        if(conn->in.size() >= maxBuffered()) break; // parse before reading more
+      }
+      else if(n == 0) {
+        // client finished sending: close once pending responses are written
+        conn->close_after_write = true;
+        conn->reading = false;
+        updateEpoll(*conn);
+        break;
+      }
+      else if(errno == EAGAIN || errno == EWOULDBLOCK) break;
+      else {
+        closeConnection(conn);
+        return;
+      }
+    }
+    conn->last_active = std::chrono::steady_clock::now();
+    processInput(conn);
+    if(!conn->closed) flush(conn);
+  }
+
+  /**
+   * Parse the buffered requests of a connection while backpressure allows it.
+   */
+  void processInput(const std::shared_ptr<Connection> &conn) {
+    size_t offset = 0;
+    while(!conn->closed && conn->inflight < options.max_inflight && queued < options.max_queued) {
+      size_t used = conn->protocol == BINARY ? parseBinary(conn, offset) : parseHttp(conn, offset);
+      if(used == 0) break;
+      offset += used;
+    }
+    if(conn->closed) return;
+    conn->in.erase(0, offset);
+    updateReading(conn);
+  }
+
+  // Read only connections below their limits, and none while the queue is full
+  void updateReading(const std::shared_ptr<Connection> &conn) {
+    bool reading = !conn->close_after_write && !paused && conn->inflight < options.max_inflight &&
+                   conn->in.size() < maxBuffered();
+    if(reading != conn->reading) {
+      conn->reading = reading;
+      updateEpoll(*conn);
+    }
+  }
+
+  size_t parseBinary(const std::shared_ptr<Connection> &conn, size_t offset) {
+    using namespace BinaryProtocol;
+    long length = frameSize((const uint8_t *)conn->in.data() + offset, conn->in.size() - offset);
+    if(length < 0) {
+      closeConnection(conn);
+      return 0;
+    }
+    if(length == 0) return 0;
+    Job job{conn, conn->next_seq++, nullptr, conn->in.substr(offset + HEADER_SIZE, length - HEADER_SIZE), true};
+    schedule(std::move(job));
+    return length;
+  }
+
+  size_t parseHttp(const std::shared_ptr<Connection> &conn, size_t offset) {
+    const std::string &in = conn->in;
+    size_t header_end = in.find("\r\n\r\n", offset);
+    if(header_end == std::string::npos) {
+      if(in.size() - offset > options.max_request_size) return rejectHttp(conn, offset, 431, "request header too large");
+      return 0;
+    }
+
+    // request line
+    size_t line_end = in.find("\r\n", offset);
+    size_t sp1 = in.find(' ', offset);
+    size_t sp2 = sp1 == std::string::npos ? sp1 : in.find(' ', sp1 + 1);
+    if(sp2 == std::string::npos || sp2 > line_end) return rejectHttp(conn, offset, 400, "bad request line");
+    std::string method = in.substr(offset, sp1 - offset);
+    std::string path = in.substr(sp1 + 1, sp2 - sp1 - 1);
+    size_t query = path.find('?');
+    if(query != std::string::npos) path.resize(query);
+    bool keep_alive = in.compare(sp2 + 1, 8, "HTTP/1.0") != 0;
+
+    // headers we care about
+    size_t content_length = 0;
+    for(size_t pos = line_end + 2; pos < header_end;) {
+      size_t eol = in.find("\r\n", pos);
+      size_t colon = in.find(':', pos);
+      if(colon != std::string::npos && colon < eol) {
+        std::string name = in.substr(pos, colon - pos);
+        for(auto &c : name) c = tolower(c);
+        size_t vstart = in.find_first_not_of(' ', colon + 1);
+        std::string value = vstart < eol ? in.substr(vstart, eol - vstart) : std::string();
+        for(auto &c : value) c = tolower(c);
+        if(name == "content-length") content_length = std::strtoul(value.c_str(), nullptr, 10);
+        else if(name == "connection") keep_alive = value == "keep-alive" || (keep_alive && value != "close");
+        else if(name == "transfer-encoding") return rejectHttp(conn, offset, 411, "chunked bodies are not supported");
+      }
+      pos = eol + 2;
+    }
+    if(content_length > options.max_request_size) return rejectHttp(conn, offset, 413, "request too large");
+    size_t total = header_end + 4 - offset + content_length;
+    if(in.size() - offset < total) return 0;
+
+    std::string body = in.substr(header_end + 4, content_length);
+    uint64_t seq = conn->next_seq++;
+    if(!keep_alive) conn->close_after_write = true;
+    auto route = routes.find(method + ' ' + path);
+    if(route == routes.end()) {
+      HttpResponse response;
+      response.status = 404;
+      response.body = "{\"error\":\"not found\"}";
+      complete(conn, seq, formatHttp(response, keep_alive));
+    }
+    else if(route->second.dispatch == INLINE) {
+      complete(conn, seq, formatHttp(route->second.handler(body.data(), body.size()), keep_alive));
+    }
+    else schedule(Job{conn, seq, &route->second, std::move(body), keep_alive});
+    return keep_alive ? total : in.size() - offset; // ignore anything sent after Connection: close
+  }
+
+  // Answer an unusable request and drop the rest of the input, the connection is closed after it
+  size_t rejectHttp(const std::shared_ptr<Connection> &conn, size_t offset, int status, const char *message) {
+    HttpResponse response;
+    response.status = status;
+    response.body = std::string("{\"error\":\"") + message + "\"}";
+    conn->close_after_write = true;
+    complete(conn, conn->next_seq++, formatHttp(response, false));
+    return conn->in.size() - offset;
+  }
+
+  static std::string formatHttp(const HttpResponse &response, bool keep_alive) {
+    const char *reason = response.status == 200 ? "OK" : response.status == 404 ? "Not Found" :
+                         response.status < 500 ? "Bad Request" : "Internal Server Error";
+    std::string out = "HTTP/1.1 " + std::to_string(response.status) + ' ' + reason + "\r\n";
+    out += "Content-Type: " + response.content_type + "\r\n";
+    out += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    out += "Access-Control-Allow-Origin: *\r\n";
+    out += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    out += response.body;
+    return out;
+  }
+
+  /**
+   * Store the response of request seq and move every response that is now in order to the output.
+   */
+  void complete(const std::shared_ptr<Connection> &conn, uint64_t seq, std::string response) {
+    conn->done[seq] = std::move(response);
+    for(auto it = conn->done.begin(); it != conn->done.end() && it->first == conn->send_seq; it = conn->done.erase(it)) {
+      conn->out += it->second;
+      conn->send_seq++;
+    }
+  }
+
+  void flush(const std::shared_ptr<Connection> &conn) {
+    while(!conn->out.empty()) {
+      ssize_t n = send(conn->fd, conn->out.data(), conn->out.size(), MSG_NOSIGNAL);
+      if(n > 0) conn->out.erase(0, n);
+      else if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+      else {
+        closeConnection(conn);
+        return;
+      }
+    }
+    bool writing = !conn->out.empty();
+    if(writing != conn->writing) {
+      conn->writing = writing;
+      updateEpoll(*conn);
+    }
+    if(!writing && conn->close_after_write && conn->send_seq == conn->next_seq) closeConnection(conn);
+  }
+
+  void schedule(Job job) {
+    std::shared_ptr<Connection> conn = job.conn;
+    conn->inflight++;
+    const bool serial = job.route && job.route->dispatch == SERIAL;
+    {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      if(serial) serial_jobs.push_back(std::move(job));
+      else {
+        conn->pending.push_back(std::move(job));
+        if(!conn->scheduled) {
+          conn->scheduled = true;
+          ready_connections.push_back(conn);
+        }
+      }
+    }
+    if(++queued >= options.max_queued) paused = true;
+    if(serial) serial_ready.notify_one();
+    else queue_ready.notify_one();
+  }
+
+  /**
+   * Worker thread: take one job from the next connection in round robin order.
+   */
+  void work() {
+    for(;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        queue_ready.wait(lock, [this] {return queue_stopping || !ready_connections.empty();});
+        if(queue_stopping) return;
+        std::shared_ptr<Connection> conn = ready_connections.front();
+        ready_connections.pop_front();
+        job = std::move(conn->pending.front());
+        conn->pending.pop_front();
+        if(conn->pending.empty()) conn->scheduled = false;
+        else ready_connections.push_back(conn);
+      }
+      queued--;
+      finish(std::move(job));
+    }
+  }
+
+  /**
+   * Serial thread: run the jobs of SERIAL routes one after the other.
+   */
+  void serialWork() {
+    for(;;) {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        serial_ready.wait(lock, [this] {return queue_stopping || !serial_jobs.empty();});
+        if(queue_stopping) return;
+        job = std::move(serial_jobs.front());
+        serial_jobs.pop_front();
+      }
+      queued--;
+      finish(std::move(job));
+    }
+  }
+
+  // Execute a job and hand its response to the network thread
+  void finish(Job job) {
+    std::string response = execute(job);
+    {
+      std::lock_guard<std::mutex> lock(completion_mutex);
+      completions.emplace_back(std::move(job), std::move(response));
+    }
+    uint64_t one = 1;
+    if(write(wake_fd, &one, sizeof(one)) < 0) {}
+  }
+
+  std::string execute(const Job &job) {
+    if(job.conn->protocol == HTTP) {
+      HttpResponse response;
+      try {
+        response = job.route->handler(job.payload.data(), job.payload.size());
+      } catch(const std::exception &) {
+        response.status = 500;
+        response.body = "{\"error\":\"internal error\"}";
+      }
+      return formatHttp(response, job.keep_alive);
+    }
+
+    using namespace BinaryProtocol;
+    Request request;
+    int scores[Position::WIDTH];
+    uint8_t status = STATUS_OK;
+    if(!decodeRequest((const uint8_t *)job.payload.data(), job.payload.size(), request) || !request.isValidPosition())
+      status = STATUS_BAD_REQUEST;
+    else if(request.opcode != OP_ANALYZE || !binary_handler) status = STATUS_UNKNOWN_OPCODE;
+    else binary_handler(request.position(), request.flags & FLAG_WEAK, scores);
+    std::string out(HEADER_SIZE + RESPONSE_SIZE, '\0');
+    encodeResponse((uint8_t *)&out[0], status, scores, binary_invalid_score);
+    return out;
+  }
+
+  /**
+   * Network thread: send the responses computed by the workers and resume paused reads.
+   */
+  void processCompletions() {
+    std::vector<std::pair<Job, std::string>> batch;
+    {
+      std::lock_guard<std::mutex> lock(completion_mutex);
+      batch.swap(completions);
+    }
+    for(auto &c : batch) {
+      const std::shared_ptr<Connection> &conn = c.first.conn;
+      conn->inflight--;
+      if(conn->closed) continue;
+      conn->last_active = std::chrono::steady_clock::now();
+      complete(conn, c.first.seq, std::move(c.second));
+      flush(conn);
+      if(!conn->closed) processInput(conn);
+    }
+    if(paused && queued < options.max_queued / 2) {
+      paused = false;
+      std::vector<std::shared_ptr<Connection>> all;
+      for(auto &c : connections) all.push_back(c.second);
+      for(auto &c : all) {
+        processInput(c);
+        if(!c->closed) flush(c);
+      }
+    }
+  }
+#endif
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,143 @@
+#ifndef BINARY_PROTOCOL_H
+#define BINARY_PROTOCOL_H
+
+#include <cstdint>
+#include <cstring>
+#include "Board.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Compact binary protocol for high rate internal clients.
+ *
+ * Every frame starts with its payload length as a little endian uint32.
+ * Clients may send many requests without waiting (pipelining): responses
+ * come back on the same connection in request order.
+ *
+ * Request payload (18 bytes):
+ *   uint8  opcode          OP_ANALYZE
+ *   uint8  flags           FLAG_WEAK for a win/draw/loss only answer
+ *   uint64 current_player  little endian bitboard of the stones of the player to play
+ *   uint64 mask            little endian bitboard of all the stones
+ * Bitboards use the Position bit order (column major, HEIGHT+1 bits per column).
+ *
+ * Response payload (8 bytes):
+ *   uint8  status          STATUS_OK or an error code
+ *   int8   scores[7]       score of each column, INVALID_SCORE for full columns
+ */
+namespace BinaryProtocol {
+
+static constexpr uint8_t OP_ANALYZE = 1;
+static constexpr uint8_t FLAG_WEAK = 1;
+
+static constexpr uint8_t STATUS_OK = 0;
+static constexpr uint8_t STATUS_BAD_REQUEST = 1;     // malformed frame or invalid position
+static constexpr uint8_t STATUS_UNKNOWN_OPCODE = 2;
+
+static constexpr int8_t INVALID_SCORE = -128;
+
+static constexpr uint32_t HEADER_SIZE = 4;
+static constexpr uint32_t REQUEST_SIZE = 18;
+static constexpr uint32_t RESPONSE_SIZE = 1 + Position::WIDTH;
+static constexpr uint32_t MAX_PAYLOAD = 1024;        // larger frames close the connection
+
+struct Request {
+  uint8_t opcode = 0;
+  uint8_t flags = 0;
+  uint64_t current_position = 0;
+  uint64_t mask = 0;
+
+  /**
+   * Check that the bitboards describe a position the solver accepts: stones on the
+   * board only, gravity respected, as many stones for the player to play as for the
+   * opponent or one less, no alignment, and at least one free cell.
+   */
+  bool isValidPosition() const {
+    Board board;
+    board.stones[0] = current_position;
+    board.stones[1] = mask ^ current_position;
+    if((current_position & ~mask) != 0 || !board.isValid()) return false;
+    const int extra = int(Position(0, board.stones[1]).nbMoves()) - int(Position(0, board.stones[0]).nbMoves());
+    return (extra == 0 || extra == 1) && !board.isGameOver();
+  }
+
+  Position position() const {
+    return Position(current_position, mask);
+  }
+};
+
+inline void writeU32(uint8_t *out, uint32_t v) {
+  for(int i = 0; i < 4; i++) out[i] = uint8_t(v >> (8 * i));
+}
+
+inline uint32_t readU32(const uint8_t *in) {
+  uint32_t v = 0;
+  for(int i = 0; i < 4; i++) v |= uint32_t(in[i]) << (8 * i);
+  return v;
+}
+
+inline void writeU64(uint8_t *out, uint64_t v) {
+  for(int i = 0; i < 8; i++) out[i] = uint8_t(v >> (8 * i));
+}
+
+inline uint64_t readU64(const uint8_t *in) {
+  uint64_t v = 0;
+  for(int i = 0; i < 8; i++) v |= uint64_t(in[i]) << (8 * i);
+  return v;
+}
+
+/**
+ * Length of the next complete frame (header included) at the start of a buffer.
+ * @return 0 if more bytes are needed, -1 if the frame is too large.
+ */
+inline long frameSize(const uint8_t *data, size_t size) {
+  if(size < HEADER_SIZE) return 0;
+  uint32_t payload = readU32(data);
+  if(payload > MAX_PAYLOAD) return -1;
+  return size >= HEADER_SIZE + payload ? long(HEADER_SIZE + payload) : 0;
+}
+
+/**
+ * Decode the payload of a request frame.
+ * @return false if the payload does not have the size of a request.
+ */
+inline bool decodeRequest(const uint8_t *payload, uint32_t size, Request &request) {
+  if(size != REQUEST_SIZE) return false;
+  request.opcode = payload[0];
+  request.flags = payload[1];
+  request.current_position = readU64(payload + 2);
+  request.mask = readU64(payload + 10);
+  return true;
+}
+
+/**
+ * Encode a full request frame (HEADER_SIZE + REQUEST_SIZE bytes).
+ */
+inline void encodeRequest(uint8_t *out, const Request &request) {
+  writeU32(out, REQUEST_SIZE);
+  out[4] = request.opcode;
+  out[5] = request.flags;
+  writeU64(out + 6, request.current_position);
+  writeU64(out + 14, request.mask);
+}
+
+/**
+ * Encode a full response frame (HEADER_SIZE + RESPONSE_SIZE bytes).
+ * @param scores: Position::WIDTH scores using the Solver convention, ignored if status is not STATUS_OK.
+ * @param invalid: value used by the solver for unplayable columns.
+ */
+inline void encodeResponse(uint8_t *out, uint8_t status, const int *scores, int invalid) {
+  writeU32(out, RESPONSE_SIZE);
+  out[4] = status;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    int8_t score = INVALID_SCORE;
+    if(status == STATUS_OK && scores[col] != invalid) score = int8_t(scores[col]);
+    out[5 + col] = uint8_t(score);
+  }
+}
+
+} // namespace BinaryProtocol
+} // namespace Connect4
+} // namespace GameSolver
+#endif
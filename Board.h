@@ -0,0 +1,125 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <cstdint>
+#include "Position.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Colored board as sent by API clients, stored as one bitboard per player.
+ *
+ * Unlike Position, which is relative to the player to play and forbids alignments,
+ * a Board keeps absolute colors (player 1 and player 2) and can represent finished games.
+ * It uses the same bit order as Position so it converts to it without any loop.
+ *
+ * Rows are numbered from the top (row 0) to the bottom (row HEIGHT-1) like the JSON board.
+ */
+struct Board {
+  uint64_t stones[2] = {0, 0}; // stones[0] for player 1, stones[1] for player 2
+
+  /**
+   * Bit of a cell given its JSON coordinates.
+   */
+  static constexpr uint64_t cell(int row, int col) {
+    return UINT64_C(1) << (col * (Position::HEIGHT + 1) + Position::HEIGHT - 1 - row);
+  }
+
+  /**
+   * Set the content of a cell.
+   * @param value: 0 (empty), 1 or 2 (player).
+   * @return false if value is not a valid cell content.
+   */
+  bool set(int row, int col, int value) {
+    if(value == 0) return true;
+    if(value != 1 && value != 2) return false;
+    stones[value - 1] |= cell(row, col);
+    return true;
+  }
+
+  /**
+   * @return 0 (empty), 1 or 2 (player) for a cell given its JSON coordinates.
+   */
+  int get(int row, int col) const {
+    const uint64_t bit = cell(row, col);
+    return (stones[0] & bit) ? 1 : (stones[1] & bit) ? 2 : 0;
+  }
+
+  /**
+   * Drop a stone of a player in a column that is not full.
+   */
+  void play(int col, int player) {
+    stones[player - 1] |= (mask() + (UINT64_C(1) << col * (Position::HEIGHT + 1))) & Position::column_mask(col);
+  }
+
+  uint64_t mask() const {
+    return stones[0] | stones[1];
+  }
+
+  int count() const {
+    return Position(0, mask()).nbMoves();
+  }
+
+  /**
+   * Indicates if the stones are on the board, respect gravity and do not overlap.
+   * A column is valid when adding its bottom bit carries over all its stones; the
+   * carry test alone would accept stones in the sentinel row above the column.
+   */
+  bool isValid() const {
+    const uint64_t m = mask();
+    return (stones[0] & stones[1]) == 0 && (m & ~board_mask()) == 0 && ((m + bottom_mask()) & m) == 0;
+  }
+
+  /**
+   * The game is over when the board is full or a player has an alignment.
+   */
+  bool isGameOver() const {
+    return count() == Position::WIDTH * Position::HEIGHT ||
+           Position::alignment(stones[0]) || Position::alignment(stones[1]);
+  }
+
+  /**
+   * Convert to a Position for the player to play.
+   * @param player: 1 or 2, the player to play.
+   */
+  Position toPosition(int player) const {
+    return Position(stones[player - 1], mask());
+  }
+
+  /**
+   * Write a compact text form: rows from top to bottom separated by '/',
+   * '.' empty, 'X' player 1, 'O' player 2.
+   * @param text: buffer of at least HEIGHT * (WIDTH + 1) chars, null terminated.
+   */
+  void toString(char *text) const {
+    int n = 0;
+    for(int row = 0; row < Position::HEIGHT; row++) {
+      for(int col = 0; col < Position::WIDTH; col++) {
+        static const char symbols[] = {'.', 'X', 'O'};
+        text[n++] = symbols[get(row, col)];
+      }
+      text[n++] = row < Position::HEIGHT - 1 ? '/' : '\0';
+    }
+  }
+
+  bool operator==(const Board &other) const {
+    return stones[0] == other.stones[0] && stones[1] == other.stones[1];
+  }
+
+ private:
+  static constexpr uint64_t bottom_mask() {
+    uint64_t m = 0;
+    for(int col = 0; col < Position::WIDTH; col++) m |= UINT64_C(1) << col * (Position::HEIGHT + 1);
+    return m;
+  }
+
+  // the WIDTH x HEIGHT playable cells, without the sentinel row of each column
+  static constexpr uint64_t board_mask() {
+    return bottom_mask() * ((UINT64_C(1) << Position::HEIGHT) - 1);
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
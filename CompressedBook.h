@@ -0,0 +1,350 @@
+#ifndef COMPRESSED_BOOK_H
+#define COMPRESSED_BOOK_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Position.h"
+#include "MappedFile.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Opening book stored as a sorted set of Position::key3 in Elias-Fano encoding.
+ *
+ * n keys below a universe U cost about 2 + log2(U/n) bits each, instead of the
+ * partial key plus the empty slots of the hashed Book, and full keys are stored: a
+ * lookup never answers for a position that was not written.
+ * Values are packed next to the keys, either the exact score (6 bits) or only its
+ * win/draw/loss class (2 bits) for books answering the weak solver.
+ *
+ * Elias-Fano: each key is split into its low_bits lowest bits, stored as is in a
+ * packed array, and its high part h, stored in unary in the high bit vector: key i
+ * sets bit h + i. The keys sharing a high part are thus a run of ones that starts
+ * after the h-th zero; a sample of the position of every SAMPLE-th zero makes
+ * finding it a few word operations, and the run is only a couple of keys long.
+ *
+ * Endgame tables (see the endgame tool) use the same encoding keyed by
+ * min(Position::key(), Position::mirrorKey()) instead: key3 does not fit in 64 bits
+ * past about 33 stones. They hold positions of at least min_moves stones.
+ *
+ * File layout (host byte order, arrays of uint64 words):
+ *   header   "C4EF", version, width, height, depth, value_bits, low_bits, key_type,
+ *            min_moves, then count, high_words, low_words, value_words, sample_count
+ *   high[high_words], low[low_words], values[value_words], samples[sample_count]
+ * The file is memory mapped, lookups touch a few cache lines.
+ */
+class CompressedBook {
+ public:
+  static constexpr uint8_t VERSION = 1;
+  static constexpr int SAMPLE = 256;     // one sampled zero position every SAMPLE zeros
+  static constexpr int EXACT_BITS = 6;   // Book value: score - MIN_SCORE + 1
+  static constexpr int WDL_BITS = 2;     // 1 loss, 2 draw, 3 win
+  static constexpr int INVALID = -2;     // getWDL of a position missing from the book
+  static constexpr int KEY3 = 0;         // key_type of opening books
+  static constexpr int POSITION_KEY = 1; // key_type of endgame tables
+
+  // Key of P in a book of the given key_type
+  static uint64_t bookKey(const Position &P, int key_type) {
+    if(key_type == KEY3) return P.key3();
+    return std::min(P.key(), P.mirrorKey());
+  }
+
+  /**
+   * Write a book file.
+   * @param entries: (bookKey, score) of the positions, sorted and deduplicated in place.
+   * @param depth: most stones of the positions.
+   * @param wdl: keep only the sign of the scores.
+   * @param min_moves: fewest stones of the positions.
+   * @return false on I/O error.
+   */
+  static bool write(const std::string &filename, std::vector<std::pair<uint64_t, int>> &entries, int depth, bool wdl,
+                    int key_type = KEY3, int min_moves = 0) {
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const std::pair<uint64_t, int> &a, const std::pair<uint64_t, int> &b) {return a.first == b.first;}),
+                  entries.end());
+    Builder builder(entries.size(), entries.empty() ? 1 : entries.back().first + 1, wdl);
+    for(const auto &entry : entries) builder.add(entry.first, entry.second);
+    return builder.write(filename, depth, key_type, min_moves);
+  }
+
+  /**
+   * Streaming construction of a book file: only the compressed arrays are held in
+   * memory, for books with more positions than fit as (key, score) pairs.
+   */
+  class Builder {
+   public:
+    /**
+     * @param n: number of positions that will be added.
+     * @param universe: greater than every key.
+     * @param wdl: keep only the sign of the scores.
+     */
+    Builder(uint64_t n, uint64_t universe, bool wdl) : n(n), value_bits(wdl ? WDL_BITS : EXACT_BITS), wdl(wdl) {
+      if(universe == 0) universe = 1;
+      while(n && (universe / n) >> (low_bits + 1)) low_bits++;
+      const uint64_t high_bits = n + ((universe - 1) >> low_bits) + 1;
+      high.resize((high_bits + 63) / 64);
+      low.resize((n * low_bits + 63) / 64 + 1);
+      values.resize((n * value_bits + 63) / 64 + 1);
+    }
+
+    /**
+     * Add the next position, keys must be strictly increasing and below universe.
+     * @return false if more than n positions are added.
+     */
+    bool add(uint64_t key, int score) {
+      if(i >= n) return false;
+      uint64_t bit = (key >> low_bits) + i;
+      high[bit / 64] |= UINT64_C(1) << (bit % 64);
+      setBits(low, i * low_bits, low_bits, key & ((UINT64_C(1) << low_bits) - 1));
+      setBits(values, i * value_bits, value_bits, wdl ? (score > 0 ? 3 : score == 0 ? 2 : 1) : score - Position::MIN_SCORE + 1);
+      i++;
+      return true;
+    }
+
+    /**
+     * Write the file once the n positions are added.
+     * @return false on I/O error or if positions are missing.
+     */
+    bool write(const std::string &filename, int depth, int key_type = KEY3, int min_moves = 0) const {
+      if(i != n) return false;
+      const std::vector<uint64_t> samples = zeroSamples();
+
+      Header header{{'C', '4', 'E', 'F'}, VERSION, Position::WIDTH, Position::HEIGHT, uint8_t(depth),
+                    uint8_t(value_bits), uint8_t(low_bits), uint8_t(key_type), uint8_t(min_moves), {},
+                    n, high.size(), low.size(), values.size(), samples.size()};
+      FILE *f = fopen(filename.c_str(), "wb");
+      if(!f) return false;
+      bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+      for(auto *array : {&high, &low, &values, &samples})
+        ok = ok && fwrite(array->data(), sizeof(uint64_t), array->size(), f) == array->size();
+      return fclose(f) == 0 && ok;
+    }
+
+   private:
+    // position of every SAMPLE-th zero of the high bits
+    std::vector<uint64_t> zeroSamples() const {
+      std::vector<uint64_t> samples;
+      for(uint64_t bit = 0, zeros = 0; bit < high.size() * 64; bit++) {
+        if(high[bit / 64] >> (bit % 64) & 1) continue;
+        if(zeros++ % SAMPLE == 0) samples.push_back(bit);
+      }
+      return samples;
+    }
+
+    uint64_t n;
+    uint64_t i = 0;
+    int low_bits = 0;
+    int value_bits;
+    bool wdl;
+    std::vector<uint64_t> high, low, values;
+  };
+
+  /**
+   * Read the header of a file.
+   * @return the value_bits of a compressed book (EXACT_BITS or WDL_BITS), 0 for any other file.
+   */
+  static int peekValueBits(const std::string &filename) {
+    Header header;
+    return peek(filename, header) ? header.value_bits : 0;
+  }
+
+  /**
+   * @return the key_type of a compressed book file, -1 for any other file.
+   */
+  static int peekKeyType(const std::string &filename) {
+    Header header;
+    return peek(filename, header) ? header.key_type : -1;
+  }
+
+  /**
+   * Map a book file built for this board size.
+   * @return false if the file is missing or invalid.
+   */
+  bool load(const std::string &filename) {
+    count = 0;
+    if(!file.open(filename)) return false;
+    Header header;
+    if(file.size() < sizeof(header)) return fail();
+    memcpy(&header, file.data(), sizeof(header));
+    if(memcmp(header.magic, "C4EF", 4) != 0 || header.version != VERSION ||
+       header.width != Position::WIDTH || header.height != Position::HEIGHT ||
+       (header.value_bits != EXACT_BITS && header.value_bits != WDL_BITS) || header.low_bits > 56 ||
+       (header.key_type != KEY3 && header.key_type != POSITION_KEY)) return fail();
+    uint64_t words = header.high_words + header.low_words + header.value_words + header.sample_count;
+    if(file.size() != sizeof(header) + words * sizeof(uint64_t) || header.sample_count == 0) return fail();
+
+    high = reinterpret_cast<const uint64_t *>(file.data() + sizeof(header));
+    low = high + header.high_words;
+    values = low + header.low_words;
+    samples = values + header.value_words;
+    high_words = header.high_words;
+    sample_count = header.sample_count;
+    low_bits = header.low_bits;
+    value_bits = header.value_bits;
+    depth = header.depth;
+    min_moves = header.min_moves;
+    key_type = header.key_type;
+    count = header.count;
+    return true;
+  }
+
+  /**
+   * @return the value of P with the Book convention (score - MIN_SCORE + 1), 0 if P is
+   *         not in the book or if the book only knows that P is won or lost.
+   */
+  int get(const Position &P) const {
+    int v = getRaw(P);
+    if(value_bits == EXACT_BITS || v == 0) return v;
+    return v == 2 ? 1 - Position::MIN_SCORE : 0;
+  }
+
+  /**
+   * @return 1 if P is won for the player to play, 0 for a draw, -1 if lost,
+   *         INVALID if P is not in the book.
+   */
+  int getWDL(const Position &P) const {
+    int v = getRaw(P);
+    if(v == 0) return INVALID;
+    if(value_bits == WDL_BITS) return v - 2;
+    int score = v + Position::MIN_SCORE - 1;
+    return (score > 0) - (score < 0);
+  }
+
+  // Number of positions in the book
+  uint64_t size() const {
+    return count;
+  }
+
+  int getDepth() const {
+    return depth;
+  }
+
+  int getMinMoves() const {
+    return min_moves;
+  }
+
+  int getKeyType() const {
+    return key_type;
+  }
+
+  bool isWDL() const {
+    return value_bits == WDL_BITS;
+  }
+
+ private:
+  struct Header {
+    char magic[4];
+    uint8_t version;
+    uint8_t width;
+    uint8_t height;
+    uint8_t depth;
+    uint8_t value_bits;
+    uint8_t low_bits;
+    uint8_t key_type;  // 0 (KEY3) in files written before endgame tables
+    uint8_t min_moves;
+    uint8_t padding[4];
+    uint64_t count;
+    uint64_t high_words;
+    uint64_t low_words;
+    uint64_t value_words;
+    uint64_t sample_count;
+  };
+
+  MappedFile file;
+  const uint64_t *high = nullptr;
+  const uint64_t *low = nullptr;
+  const uint64_t *values = nullptr;
+  const uint64_t *samples = nullptr;
+  uint64_t high_words = 0;
+  uint64_t sample_count = 0;
+  uint64_t count = 0;
+  int low_bits = 0;
+  int value_bits = 0;
+  int depth = -1;
+  int min_moves = 0;
+  int key_type = KEY3;
+
+  static bool peek(const std::string &filename, Header &header) {
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(!f) return false;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1 && memcmp(header.magic, "C4EF", 4) == 0;
+    fclose(f);
+    return ok;
+  }
+
+  static uint64_t popcount(uint64_t x) {
+    x = x - ((x >> 1) & UINT64_C(0x5555555555555555));
+    x = (x & UINT64_C(0x3333333333333333)) + ((x >> 2) & UINT64_C(0x3333333333333333));
+    x = (x + (x >> 4)) & UINT64_C(0x0f0f0f0f0f0f0f0f);
+    return (x * UINT64_C(0x0101010101010101)) >> 56;
+  }
+
+  static void setBits(std::vector<uint64_t> &array, uint64_t offset, int bits, uint64_t v) {
+    if(bits == 0) return;
+    array[offset / 64] |= v << (offset % 64);
+    if(offset % 64 + bits > 64) array[offset / 64 + 1] |= v >> (64 - offset % 64);
+  }
+
+  static uint64_t getBits(const uint64_t *array, uint64_t offset, int bits) {
+    if(bits == 0) return 0;
+    uint64_t v = array[offset / 64] >> (offset % 64);
+    if(offset % 64 + bits > 64) v |= array[offset / 64 + 1] << (64 - offset % 64);
+    return v & ((UINT64_C(1) << bits) - 1);
+  }
+
+  // position in the high bit vector of the zero of index z (0 based), or -1
+  int64_t selectZero(uint64_t z) const {
+    if(z / SAMPLE >= sample_count) return -1;
+    uint64_t pos = samples[z / SAMPLE];
+    uint64_t rank = z % SAMPLE;
+    uint64_t w = pos / 64;
+    uint64_t zeros = ~high[w] & (~UINT64_C(0) << (pos % 64));
+    for(;;) {
+      uint64_t c = popcount(zeros);
+      if(rank < c) break;
+      rank -= c;
+      if(++w >= high_words) return -1;
+      zeros = ~high[w];
+    }
+    for(; rank; rank--) zeros &= zeros - 1;
+    return w * 64 + popcount((zeros & (~zeros + 1)) - 1); // index of the lowest set bit
+  }
+
+  // raw stored value of P, 0 if absent
+  int getRaw(const Position &P) const {
+    if(count == 0 || P.nbMoves() > depth || P.nbMoves() < min_moves) return 0;
+    const uint64_t key = bookKey(P, key_type);
+    const uint64_t h = key >> low_bits;
+    const uint64_t l = key & ((UINT64_C(1) << low_bits) - 1);
+
+    int64_t bit = 0;
+    if(h > 0) {
+      bit = selectZero(h - 1);
+      if(bit < 0) return 0;
+      bit++;
+    }
+    for(uint64_t i = bit - h; uint64_t(bit) < high_words * 64 && (high[bit / 64] >> (bit % 64) & 1); bit++, i++) {
+      uint64_t low_i = getBits(low, i * low_bits, low_bits);
+      if(low_i == l) return int(getBits(values, i * value_bits, value_bits));
+      if(low_i > l) return 0;
+    }
+    return 0;
+  }
+
+  bool fail() {
+    file.close();
+    count = 0;
+    return false;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,204 @@
+#ifndef HUGE_BUFFER_H
+#define HUGE_BUFFER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Zero filled memory block for large tables probed at random, like the transposition table.
+ *
+ * With 4K pages every probe of a table of hundreds of MB is also a TLB miss. On Linux
+ * the block is an anonymous mapping backed by huge pages: reserved ones (MAP_HUGETLB)
+ * if the system has enough of them, else transparent huge pages (MADV_HUGEPAGE) aligned
+ * on HUGE_PAGE_SIZE so that the kernel can actually use them.
+ * An interleaved block spreads its pages over all the NUMA nodes (mbind MPOL_INTERLEAVE):
+ * a table shared by threads running on several sockets then has no home node whose
+ * memory bus takes all the traffic. Placement happens at first touch, the block must
+ * not be written before allocate() returns.
+ * Elsewhere the block comes from calloc.
+ *
+ * clear() gives the pages back to the kernel (MADV_DONTNEED), they are zero filled again
+ * lazily on first touch: wiping the block costs almost nothing up front.
+ */
+class HugeBuffer {
+ public:
+  static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+  HugeBuffer() = default;
+  HugeBuffer(const HugeBuffer &) = delete;
+  HugeBuffer &operator=(const HugeBuffer &) = delete;
+
+  ~HugeBuffer() {
+    release();
+  }
+
+  /**
+   * Allocate a zero filled block, replacing the previous one.
+   * @param interleave: spread the pages over the NUMA nodes.
+   * @return false if the memory cannot be allocated.
+   */
+  bool allocate(size_t bytes, bool interleave) {
+    release();
+    length = bytes;
+#ifdef __linux__
+    const size_t rounded = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+    void *p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if(p != MAP_FAILED) {
+      huge = reserved = true;
+      mapping = p;
+      mapping_size = rounded;
+      memory = static_cast<uint8_t *>(p);
+    } else {
+      // over allocate to align the block on a huge page, then give the margins back
+      p = mmap(nullptr, rounded + HUGE_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if(p == MAP_FAILED) return false;
+      uintptr_t start = (reinterpret_cast<uintptr_t>(p) + HUGE_PAGE_SIZE - 1) & ~(uintptr_t(HUGE_PAGE_SIZE) - 1);
+      size_t head = start - reinterpret_cast<uintptr_t>(p);
+      if(head) munmap(p, head);
+      if(HUGE_PAGE_SIZE - head) munmap(reinterpret_cast<void *>(start + rounded), HUGE_PAGE_SIZE - head);
+      mapping = reinterpret_cast<void *>(start);
+      mapping_size = rounded;
+      memory = static_cast<uint8_t *>(mapping);
+#ifdef MADV_HUGEPAGE
+      huge = madvise(mapping, mapping_size, MADV_HUGEPAGE) == 0;
+#endif
+    }
+    if(interleave) interleaved = interleaveNodes(mapping, mapping_size);
+    return true;
+#else
+    (void)interleave;
+    memory = static_cast<uint8_t *>(calloc(bytes, 1));
+    return memory != nullptr;
+#endif
+  }
+
+  /**
+   * Zero fill the whole block. Must not run concurrently with accesses to the block.
+   */
+  void clear() {
+    if(!memory) return;
+#ifdef __linux__
+    if(madvise(mapping, mapping_size, MADV_DONTNEED) == 0) return;
+#endif
+    parallelZero(memory, length);
+  }
+
+  /**
+   * memset(0) of a large block split between the hardware threads: a single core
+   * cannot saturate the memory bandwidth.
+   */
+  static void parallelZero(uint8_t *p, size_t bytes) {
+    const size_t CHUNK = 16 << 20;
+    size_t nb_threads = std::thread::hardware_concurrency();
+    if(nb_threads > bytes / CHUNK) nb_threads = bytes / CHUNK;
+    if(nb_threads <= 1) {
+      memset(p, 0, bytes);
+      return;
+    }
+    std::vector<std::thread> threads;
+    const size_t part = bytes / nb_threads;
+    for(size_t i = 0; i < nb_threads; i++) {
+      size_t begin = i * part;
+      size_t end = i + 1 == nb_threads ? bytes : begin + part;
+      threads.emplace_back([p, begin, end] {memset(p + begin, 0, end - begin);});
+    }
+    for(auto &thread : threads) thread.join();
+  }
+
+  void release() {
+#ifdef __linux__
+    if(mapping) munmap(mapping, mapping_size);
+    mapping = nullptr;
+    mapping_size = 0;
+#else
+    free(memory);
+#endif
+    memory = nullptr;
+    length = 0;
+    huge = reserved = interleaved = false;
+  }
+
+  uint8_t *data() const {
+    return memory;
+  }
+
+  size_t size() const {
+    return length;
+  }
+
+  // true if huge pages were requested successfully, reserved or transparent
+  bool hugePages() const {
+    return huge;
+  }
+
+  // true if the block uses reserved huge pages (MAP_HUGETLB)
+  bool reservedHugePages() const {
+    return reserved;
+  }
+
+  // true if the pages are interleaved over several NUMA nodes
+  bool isInterleaved() const {
+    return interleaved;
+  }
+
+ private:
+  uint8_t *memory = nullptr;
+  size_t length = 0;
+  bool huge = false;
+  bool reserved = false;
+  bool interleaved = false;
+#ifdef __linux__
+  void *mapping = nullptr;
+  size_t mapping_size = 0;
+
+  /**
+   * Interleave the pages of a mapping over the online NUMA nodes, without libnuma.
+   * @return false on a single node system or if the kernel refuses.
+   */
+  static bool interleaveNodes(void *address, size_t size) {
+#ifdef SYS_mbind
+    FILE *f = fopen("/sys/devices/system/node/online", "r");
+    if(!f) return false;
+    unsigned long mask[16] = {0}; // up to 1024 nodes
+    const int max_node = sizeof(mask) * 8;
+    int nodes = 0, first, last;
+    while(fscanf(f, "%d", &first) == 1) {
+      last = first;
+      int c = fgetc(f);
+      if(c == '-') {
+        if(fscanf(f, "%d", &last) != 1) break;
+        c = fgetc(f);
+      }
+      for(int node = first; node <= last && node < max_node; node++, nodes++)
+        mask[node / (8 * sizeof(unsigned long))] |= 1UL << (node % (8 * sizeof(unsigned long)));
+      if(c != ',') break;
+    }
+    fclose(f);
+    if(nodes < 2) return false;
+    const int MPOL_INTERLEAVE_MODE = 3; // MPOL_INTERLEAVE from linux/mempolicy.h
+    return syscall(SYS_mbind, address, size, MPOL_INTERLEAVE_MODE, mask, max_node + 1, 0) == 0;
+#else
+    (void)address;
+    (void)size;
+    return false;
+#endif
+  }
+#endif
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
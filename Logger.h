@@ -0,0 +1,212 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Asynchronous leveled logger writing logfmt lines (ts=... level=... event=... key=value).
+ *
+ * Producers format their line into a slot of a bounded lock-free ring buffer
+ * (Vyukov MPMC queue) and return immediately. A background thread drains the
+ * ring and writes batches to the output stream. When the ring is full the line
+ * is dropped and counted, so logging never blocks a request thread.
+ *
+ * Filtering is a single relaxed atomic load: disabled levels cost nothing
+ * but the branch, arguments are not even formatted.
+ */
+class Logger {
+ public:
+  enum Level {Debug = 0, Info = 1, Warn = 2, Error = 3, Off = 4};
+
+  static constexpr size_t LINE_SIZE = 256;  // maximum length of a line, longer lines are truncated
+  static constexpr size_t RING_SIZE = 4096; // number of slots, must be a power of two
+
+  explicit Logger(FILE *out = stdout, Level level = Info) : out(out), level(level) {
+    for(size_t i = 0; i < RING_SIZE; i++) ring[i].sequence.store(i, std::memory_order_relaxed);
+    writer = std::thread(&Logger::run, this);
+  }
+
+  ~Logger() {
+    stopping.store(true, std::memory_order_release);
+    wakeup.notify_one();
+    writer.join();
+  }
+
+  Logger(const Logger &) = delete;
+  Logger &operator=(const Logger &) = delete;
+
+  void setLevel(Level l) {
+    level.store(l, std::memory_order_relaxed);
+  }
+
+  bool enabled(Level l) const {
+    return l >= level.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Parse a level name (debug, info, warn, error, off), returns def if unknown.
+   */
+  static Level parseLevel(const char *name, Level def) {
+    if(name == nullptr) return def;
+    static const char *names[] = {"debug", "info", "warn", "error", "off"};
+    for(int i = Debug; i <= Off; i++)
+      if(strcmp(name, names[i]) == 0) return Level(i);
+    return def;
+  }
+
+  /**
+   * Number of lines lost because the ring buffer was full.
+   */
+  uint64_t getDropped() const {
+    return dropped.load(std::memory_order_relaxed);
+  }
+
+  /**
+   * Log a line, the level functions below are shortcuts.
+   * @param l: level of the line.
+   * @param event: short identifier of what happened (no spaces).
+   * @param fmt: printf style format of the key=value fields, can be nullptr.
+   */
+  void vlog(Level l, const char *event, const char *fmt, va_list args) {
+    if(!enabled(l)) return;
+    Slot *slot = claim();
+    if(slot == nullptr) {
+      dropped.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    slot->level = l;
+    slot->time = std::chrono::system_clock::now();
+    int n = snprintf(slot->text, LINE_SIZE, "event=%s", event);
+    if(fmt != nullptr && n >= 0 && size_t(n) + 1 < LINE_SIZE) {
+      slot->text[n++] = ' ';
+      vsnprintf(slot->text + n, LINE_SIZE - n, fmt, args);
+    }
+    publish(slot);
+  }
+
+  void debug(const char *event, const char *fmt = nullptr, ...) {
+    if(!enabled(Debug)) return;
+    va_list args;
+    va_start(args, fmt);
+    vlog(Debug, event, fmt, args);
+    va_end(args);
+  }
+
+  void info(const char *event, const char *fmt = nullptr, ...) {
+    if(!enabled(Info)) return;
+    va_list args;
+    va_start(args, fmt);
+    vlog(Info, event, fmt, args);
+    va_end(args);
+  }
+
+  void warn(const char *event, const char *fmt = nullptr, ...) {
+    if(!enabled(Warn)) return;
+    va_list args;
+    va_start(args, fmt);
+    vlog(Warn, event, fmt, args);
+    va_end(args);
+  }
+
+  void error(const char *event, const char *fmt = nullptr, ...) {
+    if(!enabled(Error)) return;
+    va_list args;
+    va_start(args, fmt);
+    vlog(Error, event, fmt, args);
+    va_end(args);
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    Level level;
+    std::chrono::system_clock::time_point time;
+    char text[LINE_SIZE];
+  };
+
+  FILE *out;
+  std::atomic<int> level;
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<bool> stopping{false};
+
+  Slot ring[RING_SIZE];
+  alignas(64) std::atomic<size_t> enqueue_pos{0};
+  alignas(64) size_t dequeue_pos = 0; // only touched by the writer thread
+
+  std::mutex wakeup_mutex;
+  std::condition_variable wakeup;
+  std::thread writer;
+
+  /**
+   * Reserve a free slot for a producer, nullptr if the ring is full.
+   */
+  Slot *claim() {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    for(;;) {
+      Slot *slot = &ring[pos & (RING_SIZE - 1)];
+      size_t seq = slot->sequence.load(std::memory_order_acquire);
+      intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+      if(diff == 0) {
+        if(enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) return slot;
+      }
+      else if(diff < 0) return nullptr; // full
+      else pos = enqueue_pos.load(std::memory_order_relaxed);
+    }
+  }
+
+  void publish(Slot *slot) {
+    size_t seq = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(seq + 1, std::memory_order_release);
+  }
+
+  /**
+   * Writer thread: drain the ring, write the batch, then sleep a little.
+   * Producers never notify so that logging stays free of system calls.
+   */
+  void run() {
+    static const char *names[] = {"debug", "info", "warn", "error", "off"};
+    for(;;) {
+      bool stop = stopping.load(std::memory_order_acquire);
+      size_t written = 0;
+      for(;;) {
+        Slot &slot = ring[dequeue_pos & (RING_SIZE - 1)];
+        if(slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) break;
+        char ts[32];
+        std::time_t t = std::chrono::system_clock::to_time_t(slot.time);
+        std::tm tm;
+#if defined(_WIN32)
+        gmtime_s(&tm, &t);
+#else
+        gmtime_r(&t, &tm);
+#endif
+        int ms = std::chrono::duration_cast<std::chrono::milliseconds>(slot.time.time_since_epoch()).count() % 1000;
+        strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S", &tm);
+        fprintf(out, "ts=%s.%03dZ level=%s %s\n", ts, ms, names[slot.level], slot.text);
+        slot.sequence.store(dequeue_pos + RING_SIZE, std::memory_order_release);
+        dequeue_pos++;
+        written++;
+      }
+      if(written) fflush(out);
+      if(stop) return;
+      std::unique_lock<std::mutex> lock(wakeup_mutex);
+      wakeup.wait_for(lock, std::chrono::milliseconds(20));
+    }
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,90 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Read only view of a whole file, memory mapped on POSIX systems so that pages are
+ * loaded on demand and shared between processes, read in memory elsewhere.
+ */
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() {
+    close();
+  }
+
+  /**
+   * @return false if the file cannot be read or is empty.
+   */
+  bool open(const std::string &filename) {
+    close();
+#ifdef _WIN32
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(!f) return false;
+    fseek(f, 0, SEEK_END);
+    storage.resize(ftell(f));
+    fseek(f, 0, SEEK_SET);
+    bool ok = !storage.empty() && fread(storage.data(), 1, storage.size(), f) == storage.size();
+    fclose(f);
+    if(!ok) return false;
+    bytes = storage.data();
+    length = storage.size();
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if(fd < 0) return false;
+    struct stat st;
+    void *p = fstat(fd, &st) == 0 && st.st_size > 0 ? mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if(p == MAP_FAILED) return false;
+    bytes = static_cast<const uint8_t *>(p);
+    length = st.st_size;
+#endif
+    return true;
+  }
+
+  void close() {
+#ifdef _WIN32
+    storage.clear();
+#else
+    if(bytes) munmap(const_cast<uint8_t *>(bytes), length);
+#endif
+    bytes = nullptr;
+    length = 0;
+  }
+
+  const uint8_t *data() const {
+    return bytes;
+  }
+
+  size_t size() const {
+    return length;
+  }
+
+ private:
+  const uint8_t *bytes = nullptr;
+  size_t length = 0;
+#ifdef _WIN32
+  std::vector<uint8_t> storage;
+#endif
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,127 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <cstdint>
+#include <initializer_list>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Minimal lock-free metric primitives rendered in the Prometheus text exposition format.
+ *
+ * All updates are relaxed atomic operations so they can be called from request
+ * and solver threads without any locking. A scrape reads every value independently,
+ * hence a rendered snapshot is not atomic as a whole, which is what Prometheus expects.
+ */
+
+/**
+ * Monotonically increasing counter.
+ */
+class Counter {
+ public:
+  void inc(uint64_t n = 1) {
+    value.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  uint64_t get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<uint64_t> value{0};
+};
+
+/**
+ * Value that can go up and down (in flight requests, ratios...).
+ * Stored as a double bit pattern so that fractional values are supported.
+ */
+class Gauge {
+ public:
+  void set(double v) {
+    value.store(v, std::memory_order_relaxed);
+  }
+
+  void inc(double n = 1) {
+    double v = value.load(std::memory_order_relaxed);
+    while(!value.compare_exchange_weak(v, v + n, std::memory_order_relaxed));
+  }
+
+  void dec(double n = 1) {
+    inc(-n);
+  }
+
+  double get() const {
+    return value.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<double> value{0};
+};
+
+/**
+ * Cumulative histogram with fixed bucket upper bounds expressed in seconds.
+ * The sum of the observations is kept in nanoseconds to stay on integer atomics.
+ */
+class Histogram {
+ public:
+  explicit Histogram(std::initializer_list<double> upper_bounds) :
+    bounds(upper_bounds), buckets(upper_bounds.size() + 1) {}
+
+  /**
+   * Record one observation.
+   * @param seconds: observed duration in seconds.
+   */
+  void observe(double seconds) {
+    size_t i = 0;
+    while(i < bounds.size() && seconds > bounds[i]) i++;
+    buckets[i].fetch_add(1, std::memory_order_relaxed); // last bucket is +Inf
+    sum_ns.fetch_add(static_cast<uint64_t>(seconds * 1e9), std::memory_order_relaxed);
+  }
+
+  /**
+   * Write the _bucket, _sum and _count series of the histogram.
+   */
+  void render(std::ostream &out, const std::string &name) const {
+    uint64_t cumulative = 0;
+    for(size_t i = 0; i < bounds.size(); i++) {
+      cumulative += buckets[i].load(std::memory_order_relaxed);
+      out << name << "_bucket{le=\"" << bounds[i] << "\"} " << cumulative << '\n';
+    }
+    cumulative += buckets.back().load(std::memory_order_relaxed);
+    out << name << "_bucket{le=\"+Inf\"} " << cumulative << '\n';
+    out << name << "_sum " << sum_ns.load(std::memory_order_relaxed) / 1e9 << '\n';
+    out << name << "_count " << cumulative << '\n';
+  }
+
+ private:
+  const std::vector<double> bounds;
+  std::vector<std::atomic<uint64_t>> buckets;
+  std::atomic<uint64_t> sum_ns{0};
+};
+
+/**
+ * Helpers writing the HELP/TYPE header followed by the sample(s) of a metric.
+ */
+inline void renderMetric(std::ostream &out, const std::string &name, const std::string &help, const Counter &c) {
+  out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << " counter\n";
+  out << name << ' ' << c.get() << '\n';
+}
+
+inline void renderMetric(std::ostream &out, const std::string &name, const std::string &help, const Gauge &g) {
+  out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << " gauge\n";
+  out << name << ' ' << g.get() << '\n';
+}
+
+inline void renderMetric(std::ostream &out, const std::string &name, const std::string &help, const Histogram &h) {
+  out << "# HELP " << name << ' ' << help << '\n' << "# TYPE " << name << " histogram\n";
+  h.render(out, name);
+}
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,241 @@
+#ifndef MOVE_REQUEST_H
+#define MOVE_REQUEST_H
+
+#include <cstdio>
+#include <cstring>
+#include "Board.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Decoded body of a /api/connect4-move request, small enough to live on the stack.
+ */
+struct MoveRequest {
+  Board board;
+  int current_player = 0;
+  unsigned int valid_mask = 0;   // bit i set if column i is a valid move
+  int first_valid_move = -1;     // first column listed in valid_moves
+  bool is_new_game = false;
+  bool weak = false;             // optional: win/draw/loss analysis only
+
+  /**
+   * Check the semantic constraints of the request.
+   * @return nullptr if the request is usable, an error message otherwise.
+   */
+  const char *validate() const {
+    if(!board.isValid()) return "floating stones on board";
+    if(valid_mask == 0) return "no valid moves";
+    if(current_player != 1 && current_player != 2) return "current_player must be 1 or 2";
+    return nullptr;
+  }
+};
+
+/**
+ * Hand-rolled parser for the fixed schema of the move request:
+ * {"board": int[6][7], "current_player": int, "valid_moves": int[], "is_new_game": bool, "weak": bool}
+ * where "weak" is optional.
+ *
+ * It scans the body once and fills a MoveRequest without any allocation.
+ * Unknown keys are skipped. Anything outside of the plain subset it understands
+ * (escaped keys, non integer numbers, missing keys...) makes it fail, in which case
+ * the caller is expected to fall back to a full JSON parser for a precise diagnostic.
+ */
+class MoveRequestParser {
+ public:
+  MoveRequestParser(const char *begin, const char *end) : p(begin), end(end) {}
+
+  /**
+   * @return true if the whole body was parsed into request.
+   */
+  bool parse(MoveRequest &request) {
+    enum {BOARD = 1, CURRENT_PLAYER = 2, VALID_MOVES = 4, IS_NEW_GAME = 8};
+    unsigned int seen = 0;
+    if(!consume('{')) return false;
+    if(!consume('}')) {
+      do {
+        const char *key;
+        size_t key_length;
+        if(!parseKey(key, key_length) || !consume(':')) return false;
+        if(matches(key, key_length, "board")) {
+          if(!parseBoard(request.board)) return false;
+          seen |= BOARD;
+        }
+        else if(matches(key, key_length, "current_player")) {
+          if(!parseInt(request.current_player)) return false;
+          seen |= CURRENT_PLAYER;
+        }
+        else if(matches(key, key_length, "valid_moves")) {
+          if(!parseValidMoves(request)) return false;
+          seen |= VALID_MOVES;
+        }
+        else if(matches(key, key_length, "is_new_game")) {
+          if(!parseBool(request.is_new_game)) return false;
+          seen |= IS_NEW_GAME;
+        }
+        else if(matches(key, key_length, "weak")) {
+          if(!parseBool(request.weak)) return false;
+        }
+        else if(!skipValue(0)) return false;
+      } while(consume(','));
+      if(!consume('}')) return false;
+    }
+    skipSpaces();
+    return p == end && seen == (BOARD | CURRENT_PLAYER | VALID_MOVES | IS_NEW_GAME);
+  }
+
+ private:
+  static constexpr int MAX_NESTING = 16;
+  const char *p;
+  const char *end;
+
+  void skipSpaces() {
+    while(p < end && (*p == ' ' || *p == '\n' || *p == '\r' || *p == '\t')) p++;
+  }
+
+  bool consume(char c) {
+    skipSpaces();
+    if(p < end && *p == c) {
+      p++;
+      return true;
+    }
+    return false;
+  }
+
+  static bool matches(const char *key, size_t length, const char *expected) {
+    return strlen(expected) == length && memcmp(key, expected, length) == 0;
+  }
+
+  // a key without escape sequences, returned as a pointer in the body
+  bool parseKey(const char *&key, size_t &length) {
+    if(!consume('"')) return false;
+    key = p;
+    while(p < end && *p != '"') {
+      if(*p == '\\') return false;
+      p++;
+    }
+    if(p == end) return false;
+    length = p++ - key;
+    return true;
+  }
+
+  bool parseInt(int &value) {
+    skipSpaces();
+    bool negative = p < end && *p == '-';
+    if(negative) p++;
+    if(p == end || *p < '0' || *p > '9') return false;
+    long v = 0;
+    while(p < end && *p >= '0' && *p <= '9') {
+      v = v * 10 + (*p++ - '0');
+      if(v > 1000000) return false;
+    }
+    if(p < end && (*p == '.' || *p == 'e' || *p == 'E')) return false;
+    value = negative ? -v : v;
+    return true;
+  }
+
+  bool parseLiteral(const char *literal) {
+    size_t length = strlen(literal);
+    if(size_t(end - p) < length || memcmp(p, literal, length) != 0) return false;
+    p += length;
+    return true;
+  }
+
+  bool parseBool(bool &value) {
+    skipSpaces();
+    if(parseLiteral("true")) value = true;
+    else if(parseLiteral("false")) value = false;
+    else return false;
+    return true;
+  }
+
+  bool parseBoard(Board &board) {
+    board = Board();
+    if(!consume('[')) return false;
+    for(int row = 0; row < Position::HEIGHT; row++) {
+      if(row && !consume(',')) return false;
+      if(!consume('[')) return false;
+      for(int col = 0; col < Position::WIDTH; col++) {
+        int cell;
+        if(col && !consume(',')) return false;
+        if(!parseInt(cell) || !board.set(row, col, cell)) return false;
+      }
+      if(!consume(']')) return false;
+    }
+    return consume(']');
+  }
+
+  bool parseValidMoves(MoveRequest &request) {
+    request.valid_mask = 0;
+    request.first_valid_move = -1;
+    if(!consume('[')) return false;
+    if(consume(']')) return true;
+    do {
+      int col;
+      if(!parseInt(col) || col < 0 || col >= Position::WIDTH) return false;
+      if(request.first_valid_move < 0) request.first_valid_move = col;
+      request.valid_mask |= 1u << col;
+    } while(consume(','));
+    return consume(']');
+  }
+
+  // skip any JSON value of an unknown key
+  bool skipValue(int depth) {
+    if(depth > MAX_NESTING) return false;
+    skipSpaces();
+    if(p == end) return false;
+    switch(*p) {
+      case '"':
+        for(p++; p < end && *p != '"'; p++)
+          if(*p == '\\') p++;
+        if(p >= end) return false;
+        p++;
+        return true;
+      case '[':
+        p++;
+        if(consume(']')) return true;
+        do {
+          if(!skipValue(depth + 1)) return false;
+        } while(consume(','));
+        return consume(']');
+      case '{':
+        p++;
+        if(consume('}')) return true;
+        do {
+          skipSpaces();
+          if(p == end || *p != '"' || !skipValue(depth + 1)) return false;
+          if(!consume(':') || !skipValue(depth + 1)) return false;
+        } while(consume(','));
+        return consume('}');
+      case 't': return parseLiteral("true");
+      case 'f': return parseLiteral("false");
+      case 'n': return parseLiteral("null");
+      default:
+        if(*p != '-' && (*p < '0' || *p > '9')) return false;
+        while(p < end && (*p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E' || (*p >= '0' && *p <= '9'))) p++;
+        return true;
+    }
+  }
+};
+
+/**
+ * Write the response of a move request.
+ * @param buffer: output, at least 32 chars, plus 2 per move of the principal variation.
+ * @param pv: expected continuation starting with move, omitted from the response if empty.
+ * @return number of chars written (without the final null char).
+ */
+inline int writeMoveResponse(char *buffer, size_t size, int move, const int *pv = nullptr, int pv_length = 0) {
+  int length = snprintf(buffer, size, "{\"move\":%d", move);
+  if(pv_length > 0) {
+    length += snprintf(buffer + length, size - length, ",\"pv\":[");
+    for(int i = 0; i < pv_length; i++)
+      length += snprintf(buffer + length, size - length, i ? ",%d" : "%d", pv[i]);
+    length += snprintf(buffer + length, size - length, "]");
+  }
+  length += snprintf(buffer + length, size - length, "}");
+  return length;
+}
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -6,6 +6,7 @@
 #include <cmath>
 #include "Position.h"
 #include "TranspositionTable.h"
+#include "CompressedBook.h"
 
 using namespace std;
 
@@ -26,6 +27,10 @@ namespace Connect4 {
         vector<uint8_t> values;
         
         uint64_t partial_key_mask = 0;
+
+        CompressedBook compressed; // used instead of the hashed table for "C4EF" files
+        CompressedBook wdl;        // optional win/draw/loss only book, usually deeper
+        CompressedBook endgame;    // optional table of late positions (endgame tool)
     
         uint64_t calculate_partial_key(uint64_t full_key) const {
             return full_key & partial_key_mask;
@@ -51,7 +56,21 @@ namespace Connect4 {
     public:
         Book(int w, int h) : width(w), height(h) {}
     
+        /**
+         * Load a hashed or compressed book with exact scores, replacing the previous one,
+         * or a compressed win/draw/loss book or an endgame table that are used in addition to it.
+         */
         bool load(const string& filename) {
+            if (int value_bits = CompressedBook::peekValueBits(filename)) {
+                CompressedBook& target = CompressedBook::peekKeyType(filename) == CompressedBook::POSITION_KEY ? endgame :
+                                         value_bits == CompressedBook::WDL_BITS ? wdl : compressed;
+                if (!target.load(filename)) {
+                    cerr << "Invalid compressed book: " << filename << endl;
+                    return false;
+                }
+                return true;
+            }
+
             ifstream ifs(filename, ios::binary);
             if (!ifs.is_open()) {
                 cerr << "Error opening file: " << filename << endl;
@@ -108,7 +127,40 @@ namespace Connect4 {
             return true;
         }
     
+        // Deepest positions stored in the book, -1 if none is loaded
+        int getDepth() const {
+            return compressed.size() ? compressed.getDepth() : depth;
+        }
+
+        bool hasWDL() const {
+            return wdl.size() != 0 || endgame.isWDL();
+        }
+
+        /**
+         * @return 1 if P is won for the player to play, 0 for a draw, -1 if lost,
+         *         CompressedBook::INVALID if the win/draw/loss book does not know P.
+         */
+        int getWDL(const Position& P) const {
+            int r = wdl.getWDL(P);
+            return r == CompressedBook::INVALID && endgame.isWDL() ? endgame.getWDL(P) : r;
+        }
+
+        /**
+         * Look P up in the endgame table, only for positions with enough stones.
+         * @return the value of P with the same convention as get(), 0 if unknown.
+         */
+        int getEndgame(const Position& P) const {
+            return endgame.get(P);
+        }
+
+        // Fewest stones of the positions of the endgame table, -1 if none is loaded
+        int getEndgameMinMoves() const {
+            return endgame.size() ? endgame.getMinMoves() : -1;
+        }
+
         int get(const Position& P) const {
+            if (compressed.size())
+                return compressed.get(P);
             if (depth == -1 || P.nbMoves() > depth || size == 0)
                 return 0;
     
@@ -0,0 +1,198 @@
+#ifndef PONDERER_H
+#define PONDERER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Solver.h"
+#include "MoveSorter.h"
+#include "Tactics.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Background search of the positions the opponent is likely to give us next.
+ *
+ * After we play, ponder() receives the position with the opponent to play.
+ * A low priority thread then analyzes, in order of likelihood, the position
+ * after each non losing reply of the opponent. Everything it searches goes to
+ * the shared transposition table, and completed analyses are kept so that the
+ * next request can be answered by lookup() without any search.
+ *
+ * Pondering only uses idle time: a real search calls beginSearch(), which
+ * interrupts the running pondering search, and pondering resumes once every
+ * real search has called endSearch().
+ */
+class Ponderer {
+ public:
+  Ponderer() = default;
+  Ponderer(const Ponderer &) = delete;
+  Ponderer &operator=(const Ponderer &) = delete;
+
+  ~Ponderer() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stopping = true;
+      abort = true;
+    }
+    wake.notify_all();
+    if(thread.joinable()) thread.join();
+  }
+
+  /**
+   * Start pondering with a dedicated solver, usually sharing the table of the real searches.
+   * Until start() is called, every other method does nothing.
+   */
+  void start(std::unique_ptr<Solver> ponder_solver) {
+    solver = std::move(ponder_solver);
+    solver->setAbortFlag(&abort);
+    thread = std::thread(&Ponderer::run, this);
+  }
+
+  /**
+   * Replace the pondered position.
+   * @param P: position after our move, the opponent to play.
+   */
+  void ponder(const Position &P) {
+    if(!solver) return;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      nb_replies = 0;
+      next_reply = 0;
+      generation++;
+      abort = true;
+      if(!P.canWinNext()) {
+        MoveSorter moves;
+        uint64_t possible = P.possibleNonLosingMoves();
+        for(int i = Position::WIDTH; i--;)
+          if(uint64_t move = possible & Position::column_mask(COLUMN_ORDER[i]))
+            moves.add(move, P.moveScore(move));
+        while(uint64_t move = moves.getNext()) {
+          Position P2(P);
+          P2.play(move);
+          if(tacticalMoves(P2).columns) continue; // answered without search anyway
+          replies[nb_replies].position = P2;
+          replies[nb_replies].done = false;
+          nb_replies++;
+        }
+      }
+    }
+    wake.notify_all();
+  }
+
+  // Forget the pondered position, e.g. on a new game
+  void cancel() {
+    if(!solver) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    nb_replies = 0;
+    generation++;
+    abort = true;
+  }
+
+  /**
+   * Get the scores of P if pondering already analyzed it.
+   * @return true if scores were filled.
+   */
+  bool lookup(const Position &P, int scores[Position::WIDTH]) {
+    if(!solver) return false;
+    std::lock_guard<std::mutex> lock(mutex);
+    for(int i = 0; i < nb_replies; i++) {
+      if(replies[i].done && replies[i].position.key() == P.key()) {
+        for(int col = 0; col < Position::WIDTH; col++) scores[col] = replies[i].scores[col];
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // A real search starts: pause pondering
+  void beginSearch() {
+    if(!solver) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    active_searches++;
+    abort = true;
+  }
+
+  // A real search ended: resume pondering when none is left
+  void endSearch() {
+    if(!solver) return;
+    bool resume;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      resume = --active_searches == 0;
+    }
+    if(resume) wake.notify_all();
+  }
+
+  // Number of positions analyzed in the background
+  unsigned long long getCompletedCount() const {
+    return completed.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static constexpr int COLUMN_ORDER[Position::WIDTH] = {3, 2, 4, 1, 5, 0, 6}; // center first, like the solver
+
+  struct Reply {
+    Position position;
+    int scores[Position::WIDTH];
+    bool done;
+  };
+
+  std::unique_ptr<Solver> solver;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::atomic<bool> abort{false};      // read by the pondering solver at every node
+  bool stopping = false;
+  int active_searches = 0;
+  unsigned long long generation = 0;   // changes with the pondered position
+  Reply replies[Position::WIDTH];
+  int nb_replies = 0;
+  int next_reply = 0;
+  std::atomic<unsigned long long> completed{0};
+
+  void run() {
+#ifdef __linux__
+    setpriority(PRIO_PROCESS, syscall(SYS_gettid), 19); // this thread only
+#endif
+    std::unique_lock<std::mutex> lock(mutex);
+    for(;;) {
+      wake.wait(lock, [this] {return stopping || (active_searches == 0 && next_reply < nb_replies);});
+      if(stopping) return;
+      Position P = replies[next_reply].position;
+      unsigned long long searched_generation = generation;
+      abort = false;
+      lock.unlock();
+
+      int scores[Position::WIDTH];
+      bool finished = true;
+      try {
+        solver->analyze(P, scores);
+      } catch(const Solver::Aborted &) {
+        finished = false;
+      }
+
+      lock.lock();
+      if(finished && searched_generation == generation) {
+        for(int col = 0; col < Position::WIDTH; col++) replies[next_reply].scores[col] = scores[col];
+        replies[next_reply].done = true;
+        next_reply++;
+        completed++;
+      }
+    }
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -128,6 +128,18 @@ class Position {
     return current_position + mask;
   }
 
+  /**
+   * @return the key() of the position mirrored left to right.
+   * Two symetric positions share min(key(), mirrorKey()).
+   */
+  uint64_t mirrorKey() const {
+    const uint64_t column = (UINT64_C(1) << (HEIGHT + 1)) - 1;
+    uint64_t k = key(), mirror = 0;
+    for(int col = 0; col < WIDTH; col++)
+      mirror |= ((k >> (col * (HEIGHT + 1))) & column) << ((WIDTH - 1 - col) * (HEIGHT + 1));
+    return mirror;
+  }
+
   /**
   * Build a symetric base 3 key. Two symetric positions will have the same key.
   *
@@ -190,6 +202,55 @@ class Position {
    */
   Position() : current_position{0}, mask{0}, moves{0} {}
 
+  /**
+   * Build a position directly from its bitboards, using the bit order described above.
+   * @param current_position: bitmap of the stones of the player to play.
+   * @param mask: bitmap of all the stones, must respect gravity and contain no alignment.
+   */
+  Position(uint64_t current_position, uint64_t mask) :
+    current_position{current_position}, mask{mask}, moves{popcount(mask)} {}
+
+  /**
+   * Build the position of a key(), e.g. to store positions on 8 bytes.
+   * In each column, current_position + mask is between 2^h - 1 and 2^(h+1) - 2 for a
+   * column of height h: the height is given by the highest bit of the key.
+   */
+  static Position fromKey(uint64_t key) {
+    uint64_t mask = 0;
+    for(int col = 0; col < WIDTH; col++) {
+      const uint64_t k = (key >> (col * (HEIGHT + 1))) & ((UINT64_C(1) << (HEIGHT + 1)) - 1);
+      int h = 0;
+      while((UINT64_C(2) << h) - 1 <= k) h++;
+      mask |= ((UINT64_C(1) << h) - 1) << (col * (HEIGHT + 1));
+    }
+    return Position(key - mask, mask);
+  }
+
+  /**
+   * Test an alignment of 4 stones.
+   * @param pos: bitmap of the stones of one player.
+   * @return true if the player has 4 stones aligned (vertically, horizontally or diagonally).
+   */
+  static bool alignment(uint64_t pos) {
+    // horizontal
+    uint64_t m = pos & (pos >> (HEIGHT + 1));
+    if(m & (m >> (2 * (HEIGHT + 1)))) return true;
+
+    // diagonal 1
+    m = pos & (pos >> HEIGHT);
+    if(m & (m >> (2 * HEIGHT))) return true;
+
+    // diagonal 2
+    m = pos & (pos >> (HEIGHT + 2));
+    if(m & (m >> (2 * (HEIGHT + 2)))) return true;
+
+    // vertical
+    m = pos & (pos >> 1);
+    if(m & (m >> 2)) return true;
+
+    return false;
+  }
+
   /**
    * Indicates whether a column is playable.
    * @param col: 0-based index of column to play
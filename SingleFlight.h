@@ -0,0 +1,90 @@
+#ifndef SINGLE_FLIGHT_H
+#define SINGLE_FLIGHT_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "Position.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Deduplicate concurrent analyses of the same position.
+ *
+ * The first caller for a key runs the computation, callers arriving while it is
+ * in flight wait for it and get a copy of its scores instead of searching again.
+ * Nothing is kept once the computation is done: this is not a cache, the
+ * transposition table already plays that role for sequential requests.
+ *
+ * Keys must identify the result exactly, callers fold symmetry and search
+ * options into them (see Position::mirrorKey).
+ */
+class SingleFlight {
+ public:
+  /**
+   * Get the scores of key, computing them with compute(int *scores) unless an
+   * identical computation is already running. An exception thrown by compute
+   * is rethrown to every caller sharing it.
+   * @return true if the scores come from another caller's computation.
+   */
+  template<class Compute>
+  bool run(uint64_t key, int scores[Position::WIDTH], Compute compute) {
+    std::unique_lock<std::mutex> lock(mutex);
+    auto it = calls.find(key);
+    if(it != calls.end()) {
+      std::shared_ptr<Call> call = it->second;
+      call->waiters++;
+      shared++;
+      done.wait(lock, [&call] {return call->done;});
+      if(call->error) std::rethrow_exception(call->error);
+      for(int i = 0; i < Position::WIDTH; i++) scores[i] = call->scores[i];
+      return true;
+    }
+
+    std::shared_ptr<Call> call = std::make_shared<Call>();
+    calls[key] = call;
+    lock.unlock();
+    try {
+      compute(call->scores);
+    } catch(...) {
+      call->error = std::current_exception();
+    }
+    lock.lock();
+    call->done = true;
+    calls.erase(key);
+    bool notify = call->waiters > 0;
+    lock.unlock();
+    if(notify) done.notify_all();
+
+    if(call->error) std::rethrow_exception(call->error);
+    for(int i = 0; i < Position::WIDTH; i++) scores[i] = call->scores[i];
+    return false;
+  }
+
+  // Number of callers served by another caller's computation
+  unsigned long long getSharedCount() const {
+    return shared.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Call {
+    int scores[Position::WIDTH];
+    std::exception_ptr error;
+    int waiters = 0;
+    bool done = false;
+  };
+
+  std::mutex mutex;
+  std::condition_variable done;
+  std::unordered_map<uint64_t, std::shared_ptr<Call>> calls;
+  std::atomic<unsigned long long> shared{0};
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -23,7 +23,9 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
   assert(alpha < beta);
   assert(!P.canWinNext());
 
+  const unsigned long long start_nodes = nodeCount;
   nodeCount++; // increment counter of explored nodes
+  if(abortFlag && abortFlag->load(std::memory_order_relaxed)) throw Aborted();
 
   uint64_t possible = P.possibleNonLosingMoves();
   if(possible == 0)     // if no possible non losing move, opponent wins next move
@@ -45,7 +47,10 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
   }
 
   const uint64_t key = P.key();
-  if(int val = transTable->get(key)) {
+  int hint = -1; // best move found by a previous search of P
+  if(uint64_t entry = probe(key)) {
+    int val = entry & SCORE_MASK;
+    hint = int(entry >> HINT_SHIFT) - 1;
     if(val > Position::MAX_SCORE - Position::MIN_SCORE + 1) { // we have an lower bound
       min = val + 2 * Position::MIN_SCORE - Position::MAX_SCORE - 2;
       if(alpha < min) {
@@ -61,18 +66,48 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
     }
   }
 
-  int val = book.get(P);
+  int val = book->get(P);
   if(val) 
   {
     // cout<<"val: "<<val<<'\n';
+    bookHitCount++;
     return val + Position::MIN_SCORE - 1; // look for solutions stored in opening book
   }
 
+  if(int val = book->getEndgame(P)) { // late positions solved offline by the endgame tool
+    bookHitCount++;
+    return val + Position::MIN_SCORE - 1;
+  }
+
+  if(book->hasWDL()) { // a win/draw/loss only book gives bounds, enough for weak searches
+    int wdl = book->getWDL(P);
+    if(wdl == 0) {
+      bookHitCount++;
+      return 0;
+    }
+    if(wdl == 1 && alpha < 1) {
+      alpha = 1;                       // the player to play wins: score >= 1
+      if(alpha >= beta) {
+        bookHitCount++;
+        return alpha;
+      }
+    }
+    if(wdl == -1 && beta > -1) {
+      beta = -1;                       // the player to play loses: score <= -1
+      if(alpha >= beta) {
+        bookHitCount++;
+        return beta;
+      }
+    }
+  }
+
   MoveSorter moves;
   for(int i = Position::WIDTH; i--;)
     if(uint64_t move = possible & Position::column_mask(columnOrder[i]))
-      moves.add(move, P.moveScore(move));
+      moves.add(move, columnOrder[i] == hint ? HINT_MOVE_SCORE : P.moveScore(move));
 
+  uint64_t best = 0;
+  int best_score = Position::MIN_SCORE - 1;
   while(uint64_t next = moves.getNext()) {
     Position P2(P);
     P2.play(next);  // It's opponent turn in P2 position after current player plays x column.
@@ -81,18 +116,71 @@ int Solver::negamax(const Position &P, int alpha, int beta) {
     // no need to check for score worse than alpha (opponent's score worse better than -alpha)
 
     if(score >= beta) {
-      transTable->put(key, score + Position::MAX_SCORE - 2 * Position::MIN_SCORE + 2); // save the lower bound of the position
+      store(key, (score + Position::MAX_SCORE - 2 * Position::MIN_SCORE + 2) | hintBits(next), work(nodeCount - start_nodes)); // save the lower bound of the position
       return score;  // prune the exploration if we find a possible move better than what we were looking for.
     }
+    if(score > best_score) {
+      best_score = score;
+      best = next;
+    }
     if(score > alpha) alpha = score; // reduce the [alpha;beta] window for next exploration, as we only
     // need to search for a position that is better than the best so far.
   }
 
-  transTable->put(key, alpha - Position::MIN_SCORE + 1); // save the upper bound of the position
+  store(key, (alpha - Position::MIN_SCORE + 1) | hintBits(best), work(nodeCount - start_nodes)); // save the upper bound of the position
   return alpha;
 }
 
-int Solver::solve(const Position &P, bool weak) {
+int Solver::work(unsigned long long nodes) {
+  int log = 0;
+  while(nodes >>= 1) log++;
+  return log;
+}
+
+uint64_t Solver::hintBits(uint64_t move) {
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(move & Position::column_mask(col)) return uint64_t(col + 1) << HINT_SHIFT;
+  return 0;
+}
+
+uint64_t Solver::probe(uint64_t key) {
+  tableProbeCount++;
+  if(localTable) {
+    if(uint64_t value = localTable->get(key)) {
+      localHitCount++;
+      return value;
+    }
+  }
+  uint64_t value = transTable->get(key);
+  if(value) {
+    sharedHitCount++;
+    if(localTable) localTable->put(key, value);
+  }
+  return value;
+}
+
+void Solver::store(uint64_t key, uint64_t value, int work) {
+  if(localTable) {
+    localTable->put(key, value, work);
+    if(work < sharedMinWork) return;
+  }
+  transTable->put(key, value, work);
+}
+
+bool Solver::tableBound(const Position &P, int &min, int &max) {
+  int val = probe(P.key()) & SCORE_MASK;
+  if(!val) return false;
+  if(val > Position::MAX_SCORE - Position::MIN_SCORE + 1) { // we have an lower bound
+    int lower = val + 2 * Position::MIN_SCORE - Position::MAX_SCORE - 2;
+    if(lower > min) min = lower;
+  } else {                                                  // we have an upper bound
+    int upper = val + Position::MIN_SCORE - 1;
+    if(upper < max) max = upper;
+  }
+  return true;
+}
+
+int Solver::solve(const Position &P, bool weak, int guess) {
   if(P.canWinNext()) // check if win in one move as the Negamax function does not support this case.
     return (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
   int min = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
@@ -102,34 +190,108 @@ int Solver::solve(const Position &P, bool weak) {
     max = 1;
   }
 
+  int table_min = min, table_max = max;
+  if(tableBound(P, table_min, table_max)) { // a previous search already bounded the score
+    if(guess == NO_GUESS) guess = table_min > min ? table_min : table_max;
+    if(table_min < table_max) {
+      min = table_min;
+      max = table_max;
+    }
+  }
+  bool mtdf = guess != NO_GUESS;  // converge from the guess, else bisect
+  int med = guess;
+  int last_direction = 0, same_direction = 0;
+
   while(min < max) {                    // iteratively narrow the min-max exploration window
-    int med = min + (max - min) / 2;
-    if(med <= 0 && min / 2 < med) med = min / 2;
-    else if(med >= 0 && max / 2 > med) med = max / 2;
+    if(!mtdf) {
+      med = min + (max - min) / 2;
+      if(med <= 0 && min / 2 < med) med = min / 2;
+      else if(med >= 0 && max / 2 > med) med = max / 2;
+    }
+    if(med < min) med = min;
+    if(med >= max) med = max - 1;
     int r = negamax(P, med, med + 1);   // use a null depth window to know if the actual score is greater or smaller than med
-    if(r <= med) max = r;
-    else min = r;
+    int direction = r <= med ? -1 : 1;
+    if(r <= med) {
+      max = r;
+      med = r - 1;                      // MTD(f): next probe right below the new upper bound
+    }
+    else {
+      min = r;
+      med = r;                          // MTD(f): next probe right above the new lower bound
+    }
+    // a guess far from the score: moving one bound step by step costs more than bisecting
+    same_direction = direction == last_direction ? same_direction + 1 : 0;
+    last_direction = direction;
+    if(same_direction >= 2) mtdf = false;
   }
   return min;
 }
 
-vector<int> Solver::analyze(const Position &P, bool weak) {
-  vector<int> scores(Position::WIDTH, Solver::INVALID_MOVE);
-  for (int col = 0; col < Position::WIDTH; col++)
+void Solver::analyze(const Position &P, int scores[Position::WIDTH], bool weak, int guess) {
+  if(localTable) localTable->newSearch();
+  for (int col = 0; col < Position::WIDTH; col++) {
+    scores[col] = Solver::INVALID_MOVE;
     if (P.canPlay(col)) {
       if(P.isWinningMove(col)) scores[col] = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
       else {
         Position P2(P);
         P2.playCol(col);
-        scores[col] = -solve(P2, weak);
+        scores[col] = -solve(P2, weak, guess == NO_GUESS ? NO_GUESS : -guess);
       }
     }
+  }
+}
+
+int Solver::principalVariation(const TranspositionTable &table, const Position &P, int *moves, int max_length) {
+  Position P2(P);
+  int length = 0;
+  while(length < max_length && P2.nbMoves() < Position::WIDTH * Position::HEIGHT) {
+    int col = -1;
+    if(P2.canWinNext()) { // the line ends with the winning move
+      for(int c = 0; c < Position::WIDTH; c++)
+        if(P2.canPlay(c) && P2.isWinningMove(c)) col = c;
+      moves[length++] = col;
+      break;
+    }
+    col = int(table.peek(P2.key()) >> HINT_SHIFT) - 1;
+    if(col < 0 || col >= Position::WIDTH || !P2.canPlay(col)) break;
+    moves[length++] = col;
+    P2.playCol(col);
+  }
+  return length;
+}
+
+void Solver::seedLine(TranspositionTable &table, const Position &P, const int *moves, int length) {
+  Position P2(P);
+  for(int i = 0; i < length && P2.nbMoves() < Position::WIDTH * Position::HEIGHT; i++) {
+    if(moves[i] < 0 || moves[i] >= Position::WIDTH || !P2.canPlay(moves[i]) || P2.isWinningMove(moves[i])) return;
+    uint64_t entry = table.get(P2.key());
+    if(!entry) { // no bound known: store an always true upper bound, only the hint matters
+      // no more than MAX_SCORE, larger values would decode as lower bounds
+      int upper = (Position::WIDTH * Position::HEIGHT + 1 - P2.nbMoves()) / 2;
+      if(upper > Position::MAX_SCORE) upper = Position::MAX_SCORE;
+      entry = upper - Position::MIN_SCORE + 1;
+    }
+    table.put(P2.key(), (entry & SCORE_MASK) | uint64_t(moves[i] + 1) << HINT_SHIFT);
+    P2.playCol(moves[i]);
+  }
+}
+
+vector<int> Solver::analyze(const Position &P, bool weak, int guess) {
+  vector<int> scores(Position::WIDTH);
+  analyze(P, scores.data(), weak, guess);
   return scores;
 }
 
-Solver::Solver()
+Solver::Solver() : Solver(std::make_shared<TranspositionTable>(), std::make_shared<Book>(Position::WIDTH, Position::HEIGHT))
+{
+}
+
+Solver::Solver(std::shared_ptr<TranspositionTable> table, std::shared_ptr<Book> book, int local_log_size, int shared_min_work) :
+  book(book), transTable(table), sharedMinWork(shared_min_work)
 {
-  transTable = new TranspositionTable();
+  if(local_log_size) localTable.reset(new TranspositionTable(local_log_size));
   for(int i = 0; i < Position::WIDTH; i++) // initialize the column exploration order, starting with center columns
     columnOrder[i] = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2; // example for WIDTH=7: columnOrder = {3, 4, 2, 5, 1, 6, 0}
 }
@@ -1,8 +1,10 @@
 #ifndef SOLVER_H
 #define SOLVER_H
 
+#include <atomic>
 #include <vector>
 #include <string>
+#include <memory>
 #include "Position.h"
 #include "TranspositionTable.h"
 #include "OpeningBook.h"
@@ -12,11 +14,17 @@ namespace Connect4 {
 
 class Solver {
  private:
-  static constexpr int TABLE_SIZE = 24; // store 2^TABLE_SIZE elements in the transpositiontbale
-  Book book{Position::WIDTH, Position::HEIGHT}; // opening book
+  std::shared_ptr<Book> book; // opening book, possibly shared with other solvers
   unsigned long long nodeCount = 0; // counter of explored nodes.
+  unsigned long long bookHitCount = 0; // counter of positions answered by the opening book.
   int columnOrder[Position::WIDTH]; // column exploration order
-  TranspositionTable *transTable; // transposition table
+  std::shared_ptr<TranspositionTable> transTable; // transposition table, possibly shared with other solvers
+  std::unique_ptr<TranspositionTable> localTable; // optional small private table probed first
+  int sharedMinWork = 0; // with a local table, entries cheaper than this stay out of the shared table
+  unsigned long long tableProbeCount = 0;     // transposition table lookups
+  unsigned long long localHitCount = 0;       // lookups answered by the local table
+  unsigned long long sharedHitCount = 0;      // lookups answered by the shared table
+  const std::atomic<bool> *abortFlag = nullptr; // when set and true, the running search is abandoned
 
   /**
    * Reccursively score connect 4 position using negamax variant of alpha-beta algorithm.
@@ -31,30 +39,143 @@ class Solver {
    */
   int negamax(const Position &P, int alpha, int beta);
 
+  /**
+   * Transposition table values hold the score bound in their low bits and the best
+   * move found for the position, column + 1 (0 if unknown), above HINT_SHIFT.
+   * The hint is tried first when the position is searched again, and chaining the
+   * hints from a position gives its principal variation.
+   */
+  static constexpr int HINT_SHIFT = 8;
+  static constexpr uint64_t SCORE_MASK = (uint64_t(1) << HINT_SHIFT) - 1;
+  static constexpr int HINT_MOVE_SCORE = 1000; // above any Position::moveScore
+
+  // Hint bits of a move given as a bitmap
+  static uint64_t hintBits(uint64_t move);
+
+  // Work of a search for the replacement policy of the transposition table: log2(nodes)
+  static int work(unsigned long long nodes);
+
+  /**
+   * Look a position up in the local table then in the shared one.
+   * A shared entry is copied to the local table, next lookups stay in cache.
+   * @return the stored value, 0 if missing.
+   */
+  uint64_t probe(uint64_t key);
+
+  // Store in the local table, and in the shared one if the entry cost at least sharedMinWork
+  void store(uint64_t key, uint64_t value, int work);
+
+  // Narrow [min;max] with the bound of P stored in the transposition table, if any
+  bool tableBound(const Position &P, int &min, int &max);
+
  public:
-  const int INVALID_MOVE = -1000;
+  static constexpr int INVALID_MOVE = -1000;
+  static constexpr int NO_GUESS = 1000; // no prior knowledge of the score
 
-  // Returns the score of a position
-  int solve(const Position &P, bool weak = false);
+  // Thrown out of solve() and analyze() when the abort flag is raised
+  struct Aborted {};
+
+  /**
+   * Returns the score of a position.
+   * @param guess: expected score, e.g. the score of the same player two moves earlier.
+   *        The search then converges from it with null window probes (MTD(f)) instead of
+   *        bisecting the whole score range. Without a guess, a bound stored in the
+   *        transposition table is used if there is one.
+   */
+  int solve(const Position &P, bool weak = false, int guess = NO_GUESS);
 
   // Returns the score off all possible moves of a position as an array.
   // Returns INVALID_MOVE for unplayable columns
-  std::vector<int> analyze(const Position &P, bool weak = false);
+  std::vector<int> analyze(const Position &P, bool weak = false, int guess = NO_GUESS);
+
+  // Same as above, writing the Position::WIDTH scores in a caller provided array.
+  // guess: expected score of P, used to guess the scores of the moves.
+  void analyze(const Position &P, int scores[Position::WIDTH], bool weak = false, int guess = NO_GUESS);
+
+  /**
+   * Follow the best move hints of a transposition table from P, leaving the table untouched.
+   * The line stops at the first position without a hint, e.g. a position answered by
+   * the opening book, or after a winning move.
+   * @param moves: receives the played columns.
+   * @return the number of moves of the line, at most max_length.
+   */
+  static int principalVariation(const TranspositionTable &table, const Position &P, int *moves, int max_length);
+
+  int principalVariation(const Position &P, int *moves, int max_length) const {
+    return principalVariation(*transTable, P, moves, max_length);
+  }
+
+  /**
+   * Store the moves of an expected line, starting at P, as best move hints so that
+   * the next search explores them first even if their entries were overwritten.
+   * Known bounds are kept. The line is cut at the first illegal or winning move.
+   */
+  static void seedLine(TranspositionTable &table, const Position &P, const int *moves, int length);
 
   unsigned long long getNodeCount() const {
     return nodeCount;
   }
 
+  unsigned long long getBookHitCount() const {
+    return bookHitCount;
+  }
+
+  unsigned long long getTableProbeCount() const {
+    return tableProbeCount;
+  }
+
+  unsigned long long getLocalHitCount() const {
+    return localHitCount;
+  }
+
+  unsigned long long getSharedHitCount() const {
+    return sharedHitCount;
+  }
+
+  // Estimated proportion of used slots in the transposition table
+  double getTableFillRatio() const {
+    return transTable->fillRatio();
+  }
+
   void reset() {
     nodeCount = 0;
+    bookHitCount = 0;
+    tableProbeCount = localHitCount = sharedHitCount = 0;
     transTable->reset();
+    if(localTable) localTable->reset();
+  }
+
+  /**
+   * Let another thread interrupt the searches of this solver by setting flag to true.
+   * An interrupted search throws Aborted and stores nothing partial in the transposition table.
+   */
+  void setAbortFlag(const std::atomic<bool> *flag) {
+    abortFlag = flag;
   }
 
   void loadBook(std::string book_file) {
-    book.load(book_file);
+    book->load(book_file);
+  }
+
+  const Book &getBook() const {
+    return *book;
   }
 
   Solver();
+
+  /**
+   * Build a solver using an existing transposition table and opening book.
+   * Several solvers can share them to search in parallel from different threads:
+   * the table tolerates concurrent accesses and the book is read only once loaded.
+   * @param local_log_size: if not 0, size of a private table probed before the shared
+   *        one. Small enough to stay in the CPU caches, it holds the positions of the
+   *        running search without the traffic of other searches.
+   * @param shared_min_work: with a local table, only the entries whose work
+   *        (see TranspositionTable::put) reaches it are also written to the shared
+   *        table, the cheap ones are not worth the memory traffic and the pollution.
+   */
+  Solver(std::shared_ptr<TranspositionTable> table, std::shared_ptr<Book> book,
+         int local_log_size = 0, int shared_min_work = 0);
 };
 
 } // namespace Connect4
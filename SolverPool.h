@@ -0,0 +1,161 @@
+#ifndef SOLVER_POOL_H
+#define SOLVER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Solver.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Fixed set of solvers sharing one transposition table and one opening book.
+ *
+ * A Solver is not thread safe (node counters, search state), so each search leases
+ * one for its whole duration. When every solver is busy, acquire() blocks until one
+ * is released: the pool size bounds the number of concurrent searches.
+ */
+class SolverPool {
+ public:
+  /**
+   * Exclusive access to one solver of the pool, given back on destruction.
+   */
+  class Lease {
+   public:
+    Lease(SolverPool &pool, Solver *solver) : pool(&pool), solver(solver) {}
+    Lease(Lease &&other) : pool(other.pool), solver(other.solver) {
+      other.solver = nullptr;
+    }
+    Lease(const Lease &) = delete;
+    Lease &operator=(const Lease &) = delete;
+    ~Lease() {
+      if(solver) pool->release(solver);
+    }
+
+    Solver &operator*() const {return *solver;}
+    Solver *operator->() const {return solver;}
+
+   private:
+    SolverPool *pool;
+    Solver *solver;
+  };
+
+  /**
+   * Transposition tables of the pool: one shared table, and optionally a small local
+   * table per solver in front of it (see the Solver constructor).
+   */
+  struct Options {
+    int shared_log_size = TranspositionTable::DEFAULT_LOG_SIZE;
+    int local_log_size = 0;   // 0: no local table
+    int shared_min_work = 0;  // work threshold of the shared table when local tables are used
+  };
+
+  /**
+   * @param size: number of solvers, at least one.
+   */
+  explicit SolverPool(size_t size) : SolverPool(size, Options()) {}
+
+  SolverPool(size_t size, const Options &options) :
+    options(options),
+    table(std::make_shared<TranspositionTable>(options.shared_log_size, size > 1)), // NUMA interleaved when shared by threads
+    book(std::make_shared<Book>(Position::WIDTH, Position::HEIGHT)) {
+    if(size == 0) size = 1;
+    for(size_t i = 0; i < size; i++) {
+      solvers.emplace_back(createSolver());
+      idle.push_back(solvers.back().get());
+    }
+  }
+
+  /**
+   * Load the opening book shared by all the solvers, must be called before any search.
+   */
+  bool loadBook(const std::string &book_file) {
+    return book->load(book_file);
+  }
+
+  /**
+   * Wait for an idle solver and lease it.
+   */
+  Lease acquire() {
+    std::unique_lock<std::mutex> lock(mutex);
+    if(idle.empty()) {
+      waiting++;
+      available.wait(lock, [this] {return !idle.empty();});
+      waiting--;
+    }
+    Solver *solver = idle.back();
+    idle.pop_back();
+    return Lease(*this, solver);
+  }
+
+  /**
+   * Build an extra solver outside of the pool, sharing its table and book.
+   */
+  std::unique_ptr<Solver> createSolver() {
+    return std::unique_ptr<Solver>(new Solver(table, book, options.local_log_size, options.shared_min_work));
+  }
+
+  /**
+   * Principal variation from P read from the shared table, see Solver::principalVariation.
+   * Does not need a lease: the table tolerates concurrent accesses.
+   */
+  int principalVariation(const Position &P, int *moves, int max_length) const {
+    return Solver::principalVariation(*table, P, moves, max_length);
+  }
+
+  // Seed the shared table with the hints of an expected line, see Solver::seedLine
+  void seedLine(const Position &P, const int *moves, int length) {
+    Solver::seedLine(*table, P, moves, length);
+  }
+
+  size_t size() const {
+    return solvers.size();
+  }
+
+  /**
+   * Number of callers blocked in acquire().
+   */
+  int getWaiting() const {
+    return waiting.load(std::memory_order_relaxed);
+  }
+
+  // Start a new age of the shared table, see TranspositionTable::newSearch
+  void newSearch() {
+    table->newSearch();
+  }
+
+  const TranspositionTable &getTable() const {
+    return *table;
+  }
+
+  // Estimated proportion of used slots in the shared transposition table
+  double getTableFillRatio() const {
+    return table->fillRatio();
+  }
+
+ private:
+  Options options;
+  std::shared_ptr<TranspositionTable> table;
+  std::shared_ptr<Book> book;
+  std::vector<std::unique_ptr<Solver>> solvers;
+  std::vector<Solver *> idle;
+  std::mutex mutex;
+  std::condition_variable available;
+  std::atomic<int> waiting{0};
+
+  void release(Solver *solver) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      idle.push_back(solver);
+    }
+    available.notify_one();
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
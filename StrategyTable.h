@@ -0,0 +1,203 @@
+#ifndef STRATEGY_TABLE_H
+#define STRATEGY_TABLE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Position.h"
+#include "MappedFile.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Read only table of precomputed best moves, built offline by the strategy tool.
+ *
+ * It holds one entry per position of a first player strategy: the position where the
+ * first player is to move, its best move and its score. Positions are identified by
+ * Position::key3, so both orientations of a position share one entry; moves are
+ * stored for the orientation with the smaller Position::key() and mirrored on lookup.
+ * key3 fits in 64 bits up to MAX_MOVES stones, deeper positions are left to the search.
+ *
+ * File layout (host byte order):
+ *   header  "C4ST", uint8 version, width, height, max_moves, uint64 count, uint64 nb_blocks
+ *   index   nb_blocks * {uint64 first_key, uint64 offset of the block in the data}
+ *   data    blocks of BLOCK_SIZE entries sorted by key, each entry being
+ *           varint(key - previous key), uint8 move, int8 score
+ * Keys of a strategy are dense, the deltas mostly fit in 2 to 4 bytes instead of 8.
+ * A lookup is a binary search in the index then the decoding of one block of the
+ * memory mapped file.
+ */
+class StrategyTable {
+ public:
+  static constexpr int MAX_MOVES = 32;   // 3^(MAX_MOVES + WIDTH + 1) < 2^64
+  static constexpr int BLOCK_SIZE = 64;
+  static constexpr uint8_t VERSION = 1;
+
+  struct Entry {
+    uint64_t key;
+    uint8_t move;
+    int8_t score;
+
+    bool operator<(const Entry &other) const {
+      return key < other.key;
+    }
+  };
+
+  /**
+   * Build the entry of a position.
+   * @param move: best column in the orientation of P.
+   */
+  static Entry makeEntry(const Position &P, int move, int score) {
+    return Entry{P.key3(), uint8_t(mirrored(P) ? Position::WIDTH - 1 - move : move), int8_t(score)};
+  }
+
+  /**
+   * Write a table file. Entries are sorted and deduplicated in place.
+   * @return false on I/O error.
+   */
+  static bool write(const std::string &filename, std::vector<Entry> &entries, int max_moves) {
+    std::sort(entries.begin(), entries.end());
+    entries.erase(std::unique(entries.begin(), entries.end(),
+                              [](const Entry &a, const Entry &b) {return a.key == b.key;}), entries.end());
+
+    std::vector<uint8_t> data;
+    std::vector<uint64_t> index;
+    for(size_t i = 0; i < entries.size(); i++) {
+      if(i % BLOCK_SIZE == 0) {
+        index.push_back(entries[i].key);
+        index.push_back(data.size());
+      }
+      uint64_t delta = i % BLOCK_SIZE ? entries[i].key - entries[i - 1].key : 0;
+      do {
+        data.push_back(uint8_t(delta & 0x7f) | (delta > 0x7f ? 0x80 : 0));
+        delta >>= 7;
+      } while(delta);
+      data.push_back(entries[i].move);
+      data.push_back(uint8_t(entries[i].score));
+    }
+
+    Header header{{'C', '4', 'S', 'T'}, VERSION, Position::WIDTH, Position::HEIGHT, uint8_t(max_moves),
+                  entries.size(), index.size() / 2};
+    FILE *f = fopen(filename.c_str(), "wb");
+    if(!f) return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(index.data(), sizeof(uint64_t), index.size(), f) == index.size() &&
+              fwrite(data.data(), 1, data.size(), f) == data.size();
+    return fclose(f) == 0 && ok;
+  }
+
+  /**
+   * Map a table file built for this board size.
+   * @return false if the file is missing or invalid.
+   */
+  bool load(const std::string &filename) {
+    count = nb_blocks = 0;
+    if(!file.open(filename)) return false;
+    Header header;
+    if(file.size() < sizeof(header)) return fail();
+    memcpy(&header, file.data(), sizeof(header));
+    if(memcmp(header.magic, "C4ST", 4) != 0 || header.version != VERSION ||
+       header.width != Position::WIDTH || header.height != Position::HEIGHT || header.max_moves > MAX_MOVES) return fail();
+    if(header.nb_blocks != (header.count + BLOCK_SIZE - 1) / BLOCK_SIZE ||
+       file.size() < sizeof(header) + header.nb_blocks * 2 * sizeof(uint64_t)) return fail();
+    count = header.count;
+    nb_blocks = header.nb_blocks;
+    max_moves = header.max_moves;
+    index = file.data() + sizeof(header);
+    data = index + nb_blocks * 2 * sizeof(uint64_t);
+    data_size = file.data() + file.size() - data;
+    return true;
+  }
+
+  /**
+   * Get the best move of a position.
+   * @param move: set to the best column of P.
+   * @param score: set to the score of P.
+   * @return false if P is not in the table.
+   */
+  bool get(const Position &P, int &move, int &score) const {
+    if(count == 0 || P.nbMoves() > max_moves || P.nbMoves() % 2) return false;
+    const uint64_t key = P.key3();
+
+    // last block starting at or before key
+    size_t lo = 0, hi = nb_blocks;
+    while(hi - lo > 1) {
+      size_t mid = (lo + hi) / 2;
+      if(indexEntry(mid, 0) <= key) lo = mid;
+      else hi = mid;
+    }
+    uint64_t k = indexEntry(lo, 0);
+    if(k > key) return false;
+
+    size_t offset = indexEntry(lo, 1);
+    size_t entries = std::min<uint64_t>(BLOCK_SIZE, count - lo * BLOCK_SIZE);
+    for(size_t i = 0; i < entries; i++) {
+      uint64_t delta = 0;
+      for(int shift = 0; offset < data_size; shift += 7) {
+        uint8_t byte = data[offset++];
+        delta |= uint64_t(byte & 0x7f) << shift;
+        if(!(byte & 0x80)) break;
+      }
+      if(offset + 2 > data_size) return false;
+      k += delta;
+      if(k == key) {
+        move = data[offset];
+        if(mirrored(P)) move = Position::WIDTH - 1 - move;
+        score = int8_t(data[offset + 1]);
+        return move >= 0 && move < Position::WIDTH;
+      }
+      if(k > key) return false;
+      offset += 2;
+    }
+    return false;
+  }
+
+  // Number of positions in the table
+  uint64_t size() const {
+    return count;
+  }
+
+ private:
+  struct Header {
+    char magic[4];
+    uint8_t version;
+    uint8_t width;
+    uint8_t height;
+    uint8_t max_moves;
+    uint64_t count;
+    uint64_t nb_blocks;
+  };
+
+  MappedFile file;
+  const uint8_t *index = nullptr;
+  const uint8_t *data = nullptr;
+  size_t data_size = 0;
+  uint64_t count = 0;
+  uint64_t nb_blocks = 0;
+  int max_moves = 0;
+
+  // true if moves of P are stored mirrored
+  static bool mirrored(const Position &P) {
+    return P.mirrorKey() < P.key();
+  }
+
+  uint64_t indexEntry(size_t block, int field) const {
+    uint64_t v;
+    memcpy(&v, index + (2 * block + field) * sizeof(uint64_t), sizeof(v));
+    return v;
+  }
+
+  bool fail() {
+    file.close();
+    count = nb_blocks = 0;
+    return false;
+  }
+};
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -0,0 +1,60 @@
+#ifndef TACTICS_H
+#define TACTICS_H
+
+#include "Position.h"
+
+namespace GameSolver {
+namespace Connect4 {
+
+/**
+ * Result of the tactical pre-pass on a position.
+ *
+ * columns: bitmap of equally optimal columns (bit i set for column i),
+ *          0 when there is a real choice and a search is required.
+ * exact:   true if score is the exact score of the columns, false for a single
+ *          forced block whose outcome is only known after a search.
+ * score:   score of the columns when exact is true, using the Solver convention.
+ */
+struct TacticalMoves {
+  unsigned int columns = 0;
+  bool exact = false;
+  int score = 0;
+};
+
+/**
+ * Answer positions where the move is forced by immediate tactics, without any search.
+ *
+ * - if the current player can win, all the winning columns are optimal.
+ * - if every move lets the opponent win next turn (double threat, or only moves below
+ *   an opponent winning spot), all the playable columns lose equally.
+ * - if a single move does not lose directly (forced block), it is the only sensible move.
+ *
+ * Costs a few bitboard operations, the same ones negamax does on every node.
+ */
+inline TacticalMoves tacticalMoves(const Position &P) {
+  TacticalMoves t;
+  if(P.canWinNext()) {
+    for(int col = 0; col < Position::WIDTH; col++)
+      if(P.canPlay(col) && P.isWinningMove(col)) t.columns |= 1u << col;
+    t.exact = true;
+    t.score = (Position::WIDTH * Position::HEIGHT + 1 - P.nbMoves()) / 2;
+    return t;
+  }
+
+  const uint64_t non_losing = P.possibleNonLosingMoves();
+  if(non_losing == 0) {
+    for(int col = 0; col < Position::WIDTH; col++)
+      if(P.canPlay(col)) t.columns |= 1u << col;
+    t.exact = true;
+    t.score = -(Position::WIDTH * Position::HEIGHT - P.nbMoves()) / 2;
+  }
+  else if((non_losing & (non_losing - 1)) == 0) {
+    for(int col = 0; col < Position::WIDTH; col++)
+      if(non_losing & Position::column_mask(col)) t.columns = 1u << col;
+  }
+  return t;
+}
+
+} // namespace Connect4
+} // namespace GameSolver
+#endif
@@ -2,118 +2,208 @@
 #define TRANSPOSITION_TABLE_H
 
 #include <cstring>
+#include <new>
 #include <vector>
 #include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <ostream>
+#include "HugeBuffer.h"
 
 using namespace std;
 
 namespace GameSolver {
 namespace Connect4 {
 
-/**
- * util functions to compute next prime at compile time
- */
-constexpr long long med(long long min, long long max) {
-  return (min + max) / 2;
-}
-/**
- * tells if an long longeger n has a a divisor between min (inclusive) and max (exclusive)
- */
-constexpr bool has_factor(long long n, long long min, long long max) {
-  return min * min > n ? false : // do not search for factor above sqrt(n)
-         min + 1 >= max ? n % min == 0 :
-         has_factor(n, min, med(min, max)) || has_factor(n, med(min, max), max);
-}
-
-// return next prime number greater or equal to n.
-// n must be >= 2
-constexpr long long next_prime(long long n) {
-  return has_factor(n, 2, n) ? next_prime(n + 1) : n;
-}
-
-// log2(1) = 0; log2(2) = 1; log2(3) = 1; log2(4) = 2; log2(8) = 3
-constexpr long long log2(long long n) {
-  return n <= 1 ? 0 : log2(n / 2) + 1;
-}
-
 /**
  * Transposition Table is a simple hash map with fixed storage size.
- * In case of collision we keep the last entry and overide the previous one.
- * We keep only part of the key to reduce storage, but no error is possible thanks to Chinese theorem.
+ * Each slot stores the full 64 bit key, so a lookup never returns the value of another position.
  *
- * The number of stored entries is a power of two that is defined at compile time.
- * We also define size of the entries and keys to allow optimization at compile time.
+ * The table can be shared by solvers running in different threads without locking.
+ * Keys are stored xored with their value: a slot torn by concurrent writes fails the
+ * key check on read and is reported as missing instead of returning another position's value.
+ * The slots live in a HugeBuffer: huge pages make random probes cheaper in TLB misses.
  *
- * key_size:   number of bits of the key
- * value_size: number of bits of the value
- * log_size:   base 2 log of the size of the Transposition Table.
- *             The table will contain 2^log_size elements
+ * Stored values are tagged in their EPOCH_BITS high bits with the epoch of the table,
+ * increased by reset(): entries of an older epoch read as missing, emptying the table
+ * is O(1). The memory is only wiped when the epoch counter wraps around.
+ *
+ * A key hashes to a bucket of two slots sharing a cache line. Entries are also tagged
+ * with the age of the search that stored or last read them, newSearch() starting a
+ * new age, and with the work that computed them (log2 of the searched nodes).
+ * A new entry replaces a stale one first: empty, of an older epoch or of an older age.
+ * If both slots are stale the staler one goes. Otherwise the first slot keeps the
+ * most valuable current entry: a new entry that cost at least as much work takes it
+ * and pushes that entry to the second slot, else it goes to the second slot. Entries
+ * of finished games, never read again, are thus the first to go, while the positions
+ * still useful to the current game are refreshed by each lookup and stay in place.
+ *
+ * The table stores 2^log_size entries, chosen at construction. Keys are spread over
+ * the buckets by a multiplicative hash, the full key is stored so any size is exact.
  */
 class TranspositionTable {
- private:
-  static const long long log_size = 24;
-  static const long long size = next_prime(1 << log_size); // size of the transition table. Have to be odd to be prime with 2^sizeof(key_t)
-  vector<uint64_t> K;     // Array to store truncated version of keys;
-  vector<uint64_t> V;   // Array to store values;
-
-  vector<uint64_t> getKeys() {return K;}
-  vector<uint64_t> getValues() {return V;}
-
-  long long getSize() {return size;}
+ public:
+  static constexpr int EPOCH_BITS = 8;
+  static constexpr int AGE_BITS = 8;
+  static constexpr int WORK_BITS = 6;
+  static constexpr int VALUE_BITS = 64 - EPOCH_BITS - AGE_BITS - WORK_BITS;
+  static constexpr int MAX_WORK = (1 << WORK_BITS) - 1;
+  static constexpr uint64_t VALUE_MASK = (uint64_t(1) << VALUE_BITS) - 1;
+  static constexpr uint64_t WORK_MASK = uint64_t(MAX_WORK) << VALUE_BITS;
+  static constexpr uint64_t AGE_MASK = ((uint64_t(1) << AGE_BITS) - 1) << (VALUE_BITS + WORK_BITS);
+  static constexpr uint64_t EPOCH_MASK = ~(VALUE_MASK | WORK_MASK | AGE_MASK);
+  static constexpr int BUCKET_SIZE = 2;
+  static constexpr int DEFAULT_LOG_SIZE = 24;
+  static constexpr int MIN_LOG_SIZE = 4;
+  static constexpr int MAX_LOG_SIZE = 36;
 
-  long long getKeySize() 
-  {
-    return (long long)K.size();
+ private:
+  long long size;        // number of entries of the table
+  int bucket_shift;      // 64 - log2(number of buckets)
+
+  // key and value of a slot side by side, a bucket fits in a single cache line
+  struct Entry {
+    uint64_t key;   // full key, xored with the value
+    uint64_t value;
+  };
+  HugeBuffer memory;
+  Entry *T;
+  uint64_t epoch = 0; // tag of the valid entries, already shifted to the high bits
+  std::atomic<uint64_t> age{0}; // age of the current search, already shifted, moved on while other threads search
+
+  Entry *bucket(uint64_t key) const {
+    return T + ((key * UINT64_C(0x9E3779B97F4A7C15)) >> bucket_shift) * BUCKET_SIZE;
   }
-  long long getValueSize() 
-  {
-    return (long long)V.size();
+
+  bool matches(const Entry &entry, uint64_t key) const {
+    return (entry.key ^ entry.value) == key && (entry.value & EPOCH_MASK) == epoch;
   }
 
-  long long index(long long key) const {
-    return key % size;
+  // number of searches since the entry was used, 1 << AGE_BITS if empty or stale
+  uint64_t staleness(uint64_t value) const {
+    if(!value || (value & EPOCH_MASK) != epoch) return uint64_t(1) << AGE_BITS;
+    return ((age.load(std::memory_order_relaxed) - (value & AGE_MASK)) & AGE_MASK) >> (VALUE_BITS + WORK_BITS);
   }
 
  public:
-  TranspositionTable() {
-    K = vector<uint64_t>(size); // Array to store truncated version of keys;
-    V = vector<uint64_t>(size); // Array to store values;
-    reset();
+  /**
+   * @param log_size: base 2 log of the number of entries, clamped to [MIN_LOG_SIZE;MAX_LOG_SIZE].
+   *        An entry takes 16 bytes.
+   * @param interleave: spread the table over the NUMA nodes, for a table shared by
+   *        threads that may run on different sockets.
+   */
+  explicit TranspositionTable(int log_size = DEFAULT_LOG_SIZE, bool interleave = false) {
+    log_size = std::min(std::max(log_size, MIN_LOG_SIZE), MAX_LOG_SIZE);
+    size = 1LL << log_size;
+    bucket_shift = 64 - (log_size - 1); // BUCKET_SIZE entries per bucket
+    if(!memory.allocate(size * sizeof(Entry), interleave)) throw std::bad_alloc();
+    T = reinterpret_cast<Entry *>(memory.data()); // fresh pages are already zero filled
   }
 
   ~TranspositionTable()  = default;
 
   /**
    * Empty the Transition Table.
+   * Must not run concurrently with searches using the table.
    */
   void reset() {
-    fill(K.begin(), K.end(), 0);
-    fill(V.begin(), V.end(), 0);
+    epoch = (epoch + (uint64_t(1) << (VALUE_BITS + WORK_BITS + AGE_BITS))) & EPOCH_MASK;
+    if(epoch == 0) memory.clear(); // wrapped around: entries of epoch 0 may still be there
+  }
+
+  /**
+   * Start a new age: entries not used since then become the first candidates for
+   * replacement. Typically called once per move of a game.
+   */
+  void newSearch() {
+    age.store((age.load(std::memory_order_relaxed) + (uint64_t(1) << (VALUE_BITS + WORK_BITS))) & AGE_MASK, std::memory_order_relaxed);
+  }
+
+  // number of entries
+  long long getSize() const {
+    return size;
+  }
+
+  // true if the table is backed by huge pages
+  bool hugePages() const {
+    return memory.hugePages();
+  }
+
+  // true if the table is spread over several NUMA nodes
+  bool isInterleaved() const {
+    return memory.isInterleaved();
   }
 
   /**
    * Store a value for a given key
-   * @param key: must be less than key_size bits.
-   * @param value: must be less than value_size bits. null (0) value is used to encode missing data
+   * @param key: a Position::key().
+   * @param value: must be less than VALUE_BITS bits. null (0) value is used to encode missing data
+   * @param work: cost of computing the value, e.g. log2 of the searched nodes, capped to MAX_WORK.
    */
-  void put(uint64_t key, uint64_t value) {
-    long long pos = index(key);
-    K[pos] = key; // key is possibly trucated as key_t is possibly less than key_size bits.
-    V[pos] = value;
+  void put(uint64_t key, uint64_t value, int work = 0) {
+    value |= epoch | age.load(std::memory_order_relaxed) | uint64_t(work < MAX_WORK ? work : MAX_WORK) << VALUE_BITS;
+    Entry *b = bucket(key);
+    Entry *victim;
+    if(matches(b[0], key)) victim = b;          // update the entry of the same position
+    else if(matches(b[1], key)) victim = b + 1;
+    else if(const uint64_t stale0 = staleness(b[0].value)) {
+      victim = staleness(b[1].value) > stale0 ? b + 1 : b; // the staler slot, a current entry stays
+    }
+    else if((value & WORK_MASK) >= (b[0].value & WORK_MASK)) {
+      b[1] = b[0];                               // the first slot keeps the most valuable entry
+      victim = b;
+    }
+    else victim = b + 1;
+    victim->key = key ^ value; // full key, xored so that a torn slot fails the check
+    victim->value = value;
   }
 
   /**
    * Get the value of a key
-   * @param key: must be less than key_size bits.
+   * An entry of an older age is refreshed to the current one.
+   * @param key: a Position::key().
    * @return value_size bits value associated with the key if present, 0 otherwise.
    */
-  uint64_t get(uint64_t key) const {
-    long long pos = index(key);
-    // cerr<<"key: "<<key<<", pos: "<<pos<<", K[pos]: "<<K[pos]<<'\n';
-    if(K[pos] == key) return V[pos]; // need to cast to key_t because key may be truncated due to size of key_t
-    else return 0;
+  uint64_t get(uint64_t key) {
+    Entry *b = bucket(key);
+    const uint64_t current = age.load(std::memory_order_relaxed);
+    for(int i = 0; i < BUCKET_SIZE; i++) {
+      const uint64_t value = b[i].value;
+      if((b[i].key ^ value) != key || (value & EPOCH_MASK) != epoch) continue; // entries of an older epoch are stale
+      if((value & AGE_MASK) != current) {
+        const uint64_t refreshed = (value & ~AGE_MASK) | current;
+        b[i].key = key ^ refreshed;
+        b[i].value = refreshed;
+      }
+      return value & VALUE_MASK;
+    }
+    return 0;
+  }
+
+  /**
+   * Get the value of a key without refreshing its age, e.g. to read the table between searches.
+   * @param key: a Position::key().
+   * @return value_size bits value associated with the key if present, 0 otherwise.
+   */
+  uint64_t peek(uint64_t key) const {
+    const Entry *b = bucket(key);
+    for(int i = 0; i < BUCKET_SIZE; i++)
+      if(matches(b[i], key)) return b[i].value & VALUE_MASK;
+    return 0;
+  }
+
+  /**
+   * Estimate the proportion of used slots by probing evenly spaced entries.
+   * @param samples: number of slots to look at, the estimate is exact if samples >= size.
+   * @return a ratio between 0 and 1.
+   */
+  double fillRatio(long long samples = 1 << 16) const {
+    if(samples > size) samples = size;
+    const long long step = size / samples;
+    long long used = 0;
+    for(long long i = 0; i < samples; i++)
+      if(T[i * step].value && (T[i * step].value & EPOCH_MASK) == epoch) used++;
+    return (double)used / samples;
   }
 };
 
@@ -0,0 +1,354 @@
+#include "Position.h"
+#include "TranspositionTable.h"
+#include "OpeningBook.h"
+#include "CompressedBook.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Microbenchmarks of the primitives of the search, in nanoseconds per operation.
+ *
+ * usage: bench [-f filter] [-r repeats] [-t min_ms] [-s seed] [-b book] [-o results_file] [-c baseline_file]
+ *
+ * Positions come from games of random non losing moves (as played by the sampler),
+ * every position of each game: a realistic mix of openings, middle games and
+ * endgames. Position primitives loop over SMALL_SET positions, which stay in the
+ * CPU caches: they measure computation. Transposition table operations use the
+ * keys of LARGE_SET positions on a table of the default size, so that probes miss
+ * the caches like in a real search.
+ * Each benchmark runs passes over its positions for at least min_ms, repeats
+ * times, and reports the fastest and median ns/op: the fastest is the least noisy.
+ * To compare commits, save the results of one build with -o and run the other one
+ * with -c: the change of the fastest time is shown for each benchmark.
+ * Book::get is measured on the opening book if it can be loaded (-b, default
+ * 7x6.book), else on a synthetic hashed book of the same size, and on a compressed
+ * book of all the positions up to COMPRESSED_DEPTH stones.
+ *   -f filter  only the benchmarks whose name contains filter
+ *   -r repeats measures of each benchmark (default 5)
+ *   -t min_ms  minimum duration of a measure (default 100)
+ *   -s seed    seed of the random games (default 1)
+ */
+
+static const size_t SMALL_SET = 1 << 14;
+static const size_t LARGE_SET = 1 << 21;
+static const int COMPRESSED_DEPTH = 10;
+
+// Keep the compiler from optimizing away a value that is never used
+template<class T> inline void keep(const T &value) {
+#if defined(__GNUC__)
+  asm volatile("" : : "r,m"(value) : "memory");
+#else
+  static volatile T sink;
+  sink = value;
+#endif
+}
+
+// Positions of random games, not full and with no alignment
+static vector<Position> randomPositions(size_t count, mt19937_64 &rng) {
+  vector<Position> positions;
+  positions.reserve(count);
+  while(positions.size() < count) {
+    Position P;
+    while(positions.size() < count && P.nbMoves() < Position::WIDTH * Position::HEIGHT) {
+      positions.push_back(P);
+      if(P.canWinNext()) break; // the next move ends the game
+      const uint64_t candidates = P.possibleNonLosingMoves();
+      int columns[Position::WIDTH], nb_columns = 0;
+      for(int col = 0; col < Position::WIDTH; col++)
+        if(candidates ? candidates & Position::column_mask(col) : P.canPlay(col)) columns[nb_columns++] = col;
+      if(nb_columns == 0) break;
+      P.playCol(columns[rng() % nb_columns]);
+    }
+  }
+  shuffle(positions.begin(), positions.end(), rng);
+  return positions;
+}
+
+// (key3, random score) of every position up to depth stones the player to play cannot win at once,
+// each once: visited holds the key3 of the positions already reached by another sequence
+static void enumerate(const Position &P, int depth, vector<pair<uint64_t, int>> &entries,
+                      unordered_set<uint64_t> &visited, mt19937_64 &rng) {
+  if(P.canWinNext() || !visited.insert(P.key3()).second) return;
+  entries.emplace_back(P.key3(), int(rng() % 10) - 5);
+  if(P.nbMoves() == depth) return;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    if(!P.canPlay(col)) continue;
+    Position P2(P);
+    P2.playCol(col);
+    enumerate(P2, depth, entries, visited, rng);
+  }
+}
+
+struct Result {
+  double best;   // ns/op
+  double median; // ns/op
+};
+
+class Runner {
+ public:
+  Runner(const string &filter, int repeats, double min_seconds) :
+    filter(filter), repeats(repeats), min_seconds(min_seconds) {}
+
+  /**
+   * Measure a benchmark.
+   * @param pass: runs one pass and returns the number of operations it did.
+   */
+  void run(const string &name, const function<size_t()> &pass) {
+    if(name.find(filter) == string::npos) return;
+    pass(); // warm up caches and branch predictors
+    vector<double> measures;
+    for(int r = 0; r < repeats; r++) {
+      size_t ops = 0;
+      const auto start = chrono::steady_clock::now();
+      double elapsed;
+      do {
+        ops += pass();
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      } while(elapsed < min_seconds);
+      measures.push_back(elapsed * 1e9 / ops);
+    }
+    sort(measures.begin(), measures.end());
+    results.emplace_back(name, Result{measures.front(), measures[measures.size() / 2]});
+    print(results.back().first, results.back().second);
+  }
+
+  // true if one of the names is selected by the filter
+  bool selected(const vector<string> &names) const {
+    for(const string &name : names)
+      if(name.find(filter) != string::npos) return true;
+    return false;
+  }
+
+  void setBaseline(const map<string, double> &baseline) {
+    this->baseline = baseline;
+  }
+
+  void printHeader() const {
+    printf("%-34s %10s %10s", "benchmark", "ns/op", "median");
+    if(!baseline.empty()) printf(" %10s %8s", "baseline", "change");
+    printf("\n");
+  }
+
+  // Write "name ns/op" lines, the format read by readResults
+  bool save(const string &filename) const {
+    ofstream out(filename);
+    for(const auto &result : results) out << result.first << " " << result.second.best << "\n";
+    return bool(out);
+  }
+
+  static bool readResults(const string &filename, map<string, double> &results) {
+    ifstream in(filename);
+    if(!in) return false;
+    string name;
+    double ns;
+    while(in >> name >> ns) results[name] = ns;
+    return true;
+  }
+
+ private:
+  string filter;
+  int repeats;
+  double min_seconds;
+  vector<pair<string, Result>> results;
+  map<string, double> baseline;
+
+  void print(const string &name, const Result &result) const {
+    printf("%-34s %10.3f %10.3f", name.c_str(), result.best, result.median);
+    auto it = baseline.find(name);
+    if(it != baseline.end()) printf(" %10.3f %+7.1f%%", it->second, (result.best / it->second - 1) * 100);
+    printf("\n");
+    fflush(stdout);
+  }
+};
+
+// Write a hashed book file of random content: the lookups cost the same as in a real one
+static bool writeSyntheticBook(const string &filename, mt19937_64 &rng) {
+  const int depth = 12, partial_key_bytes = 1, log_size = 21;
+  FILE *f = fopen(filename.c_str(), "wb");
+  if(!f) return false;
+  const char header[6] = {char(Position::WIDTH), char(Position::HEIGHT), char(depth), char(partial_key_bytes), 1, char(log_size)};
+  bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header);
+  // partial keys then values, for a table of the next prime after 2^log_size entries
+  vector<uint8_t> content(2 * ((size_t(1) << log_size) + (1 << 16)) * partial_key_bytes);
+  for(auto &byte : content) byte = uint8_t(rng());
+  ok = ok && fwrite(content.data(), 1, content.size(), f) == content.size();
+  return fclose(f) == 0 && ok;
+}
+
+int main(int argc, char **argv) {
+  string filter, book_file = "7x6.book", output, baseline_file;
+  int repeats = 5;
+  double min_ms = 100;
+  unsigned long long seed = 1;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-f" && i + 1 < argc) filter = argv[++i];
+    else if(arg == "-r" && i + 1 < argc) repeats = stoi(argv[++i]);
+    else if(arg == "-t" && i + 1 < argc) min_ms = stod(argv[++i]);
+    else if(arg == "-s" && i + 1 < argc) seed = stoull(argv[++i]);
+    else if(arg == "-b" && i + 1 < argc) book_file = argv[++i];
+    else if(arg == "-o" && i + 1 < argc) output = argv[++i];
+    else if(arg == "-c" && i + 1 < argc) baseline_file = argv[++i];
+    else repeats = 0; // usage
+  }
+  if(repeats <= 0 || min_ms <= 0) {
+    cerr << "usage: " << argv[0] << " [-f filter] [-r repeats] [-t min_ms] [-s seed] [-b book] [-o results_file] [-c baseline_file]" << endl;
+    return 1;
+  }
+
+  Runner runner(filter, repeats, min_ms / 1000);
+  if(!baseline_file.empty()) {
+    map<string, double> baseline;
+    if(!Runner::readResults(baseline_file, baseline)) {
+      cerr << "Error reading " << baseline_file << endl;
+      return 1;
+    }
+    runner.setBaseline(baseline);
+  }
+
+  mt19937_64 rng(seed);
+  const vector<Position> positions = randomPositions(SMALL_SET, rng);
+  vector<Position> open;          // positions where the player to play cannot win at once
+  vector<pair<Position, uint64_t>> moves; // a non losing move of each open position
+  vector<int> columns;            // a playable column of each position
+  for(const Position &P : positions) {
+    int col;
+    do col = rng() % Position::WIDTH; while(!P.canPlay(col));
+    columns.push_back(col);
+    if(P.canWinNext()) continue;
+    open.push_back(P);
+    uint64_t candidates = P.possibleNonLosingMoves();
+    if(!candidates) continue;
+    moves.emplace_back(P, candidates & (0 - candidates)); // lowest move
+  }
+  vector<uint64_t> keys;
+  for(const Position &P : randomPositions(LARGE_SET, rng)) keys.push_back(P.key());
+
+  runner.printHeader();
+
+  runner.run("Position::playCol", [&]() {
+    for(size_t i = 0; i < positions.size(); i++) {
+      Position P(positions[i]);
+      P.playCol(columns[i]);
+      keep(P);
+    }
+    return positions.size();
+  });
+
+  runner.run("Position::play", [&]() {
+    for(const auto &move : moves) {
+      Position P(move.first);
+      P.play(move.second);
+      keep(P);
+    }
+    return moves.size();
+  });
+
+  runner.run("Position::canWinNext", [&]() {
+    for(const Position &P : positions) keep(P.canWinNext());
+    return positions.size();
+  });
+
+  runner.run("Position::possibleNonLosingMoves", [&]() {
+    for(const Position &P : open) keep(P.possibleNonLosingMoves());
+    return open.size();
+  });
+
+  runner.run("Position::moveScore", [&]() {
+    for(const auto &move : moves) keep(move.first.moveScore(move.second));
+    return moves.size();
+  });
+
+  runner.run("Position::key", [&]() {
+    for(const Position &P : positions) keep(P.key());
+    return positions.size();
+  });
+
+  runner.run("Position::key3", [&]() {
+    for(const Position &P : positions) keep(P.key3());
+    return positions.size();
+  });
+
+  if(runner.selected({"TranspositionTable::put", "TranspositionTable::get", "TranspositionTable::get_miss"})) {
+    TranspositionTable table;
+    runner.run("TranspositionTable::put", [&]() {
+      for(size_t i = 0; i < keys.size(); i++) table.put(keys[i], (i & 0xff) + 1, int(i & 15));
+      return keys.size();
+    });
+    runner.run("TranspositionTable::get", [&]() { // on a full table: mostly hits
+      for(uint64_t key : keys) keep(table.get(key));
+      return keys.size();
+    });
+    table.reset();
+    runner.run("TranspositionTable::get_miss", [&]() { // on an empty table
+      for(uint64_t key : keys) keep(table.get(key));
+      return keys.size();
+    });
+  }
+
+  if(runner.selected({"Book::get", "Book::get_synthetic", "Book::get_compressed"})) {
+    const string tmp_dir = P_tmpdir;
+    Book book(Position::WIDTH, Position::HEIGHT);
+    const string synthetic = tmp_dir + "/bench-" + to_string(getpid()) + ".book";
+    string hashed_name = "Book::get";
+    if(!book.load(book_file)) {
+      cerr << "Using a synthetic book" << endl;
+      if(!writeSyntheticBook(synthetic, rng) || !book.load(synthetic)) {
+        cerr << "Error writing " << synthetic << endl;
+        return 1;
+      }
+      hashed_name = "Book::get_synthetic";
+    }
+    remove(synthetic.c_str());
+    vector<Position> book_positions; // positions the solver looks up in the book
+    for(const Position &P : open)
+      if(P.nbMoves() <= book.getDepth()) book_positions.push_back(P);
+    runner.run(hashed_name, [&]() {
+      for(const Position &P : book_positions) keep(book.get(P));
+      return book_positions.size();
+    });
+
+    // like a converted opening book: every position up to COMPRESSED_DEPTH stones
+    vector<pair<uint64_t, int>> entries;
+    {
+      unordered_set<uint64_t> visited;
+      enumerate(Position(), COMPRESSED_DEPTH, entries, visited, rng);
+    }
+    vector<Position> compressed_positions;
+    for(const Position &P : open)
+      if(P.nbMoves() <= COMPRESSED_DEPTH) compressed_positions.push_back(P);
+    const string compressed_file = tmp_dir + "/bench-" + to_string(getpid()) + ".cbook";
+    Book compressed(Position::WIDTH, Position::HEIGHT);
+    const bool loaded = CompressedBook::write(compressed_file, entries, COMPRESSED_DEPTH, false) &&
+                        compressed.load(compressed_file);
+    remove(compressed_file.c_str()); // still mapped
+    if(!loaded) {
+      cerr << "Error writing " << compressed_file << endl;
+      return 1;
+    }
+    runner.run("Book::get_compressed", [&]() {
+      for(const Position &P : compressed_positions) keep(compressed.get(P));
+      return compressed_positions.size();
+    });
+  }
+
+  if(!output.empty() && !runner.save(output)) {
+    cerr << "Error writing " << output << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,89 @@
+#include "Solver.h"
+#include "CompressedBook.h"
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Convert an opening book to the compressed format (see CompressedBook).
+ *
+ * usage: bookconv [-w] [-s depth] input_book output_book
+ *
+ * The hashed Book only keeps partial keys, so its positions cannot be listed:
+ * every position up to the book depth is enumerated and looked up instead. A
+ * position missing from the input book but sharing the partial key of one of its
+ * entries gets that entry's value: the converted book keeps the answers of the input
+ * book, including those collisions, as entries of their own.
+ * Positions the player to play can win at once are skipped, the solver never
+ * asks the book about them.
+ *   -w        keep only win/draw/loss, 2 bits per position
+ *   -s depth  build a deeper book: positions up to depth missing from the input
+ *             book are solved (slow, offline only)
+ */
+
+static Solver solver;
+static unordered_set<uint64_t> visited;
+static vector<pair<uint64_t, int>> entries;
+static int depth;
+static bool solve_missing = false;
+static unsigned long long solved = 0;
+
+void enumerate(const Position &P) {
+  if(!visited.insert(P.key3()).second) return;
+  if(P.canWinNext()) return; // the game ends here
+
+  int val = solver.getBook().get(P);
+  if(val) entries.emplace_back(P.key3(), val + Position::MIN_SCORE - 1);
+  else if(solve_missing) {
+    entries.emplace_back(P.key3(), solver.solve(P));
+    if(++solved % 1000 == 0) cerr << solved << " positions solved" << endl;
+  }
+
+  if(P.nbMoves() >= depth) return;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    if(!P.canPlay(col)) continue;
+    Position P2(P);
+    P2.playCol(col);
+    enumerate(P2);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool wdl = false;
+  int solve_depth = -1;
+  vector<string> files;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-w") wdl = true;
+    else if(arg == "-s" && i + 1 < argc) solve_depth = stoi(argv[++i]);
+    else files.push_back(arg);
+  }
+  if(files.size() != 2) {
+    cerr << "usage: " << argv[0] << " [-w] [-s depth] input_book output_book" << endl;
+    return 1;
+  }
+
+  solver.loadBook(files[0]);
+  depth = solver.getBook().getDepth();
+  if(solve_depth >= 0) {
+    depth = solve_depth;
+    solve_missing = true;
+  }
+  if(depth < 0) {
+    cerr << "No book depth: load a hashed book or use -s" << endl;
+    return 1;
+  }
+
+  enumerate(Position());
+  cerr << entries.size() << " positions up to depth " << depth << ", " << solved << " solved" << endl;
+  if(!CompressedBook::write(files[1], entries, depth, wdl)) {
+    cerr << "Error writing " << files[1] << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,133 @@
+#include "Position.h"
+#include "CompressedBook.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Build an endgame table: the exact score of every position with at most empty_cells
+ * empty cells reachable from the root positions, by retrograde analysis.
+ *
+ * usage: endgame [-e empty_cells] [-w] output_file < roots
+ *
+ * Roots are move sequences, one per line (the empty line is the empty board).
+ * Positions are expanded forward one layer (number of stones) at a time, each layer
+ * deduplicated, games ending on a winning move are not expanded. Scores are then
+ * computed backward from the full board: a position is worth the best of minus the
+ * score of its children, already known from the next layer. No search is involved.
+ *
+ * The table is keyed by min(Position::key(), Position::mirrorKey()), see CompressedBook.
+ * Like the opening book it leaves out the positions the solver never looks up: the
+ * player to play can win at once, or 40 stones and more.
+ * Layers are held in memory: keep the roots late enough for their subtree to fit,
+ * e.g. 12 empty cells below positions of 24 stones or more.
+ *   -e empty_cells  deepest layer stored: Position::WIDTH * Position::HEIGHT - empty_cells
+ *   -w              keep only win/draw/loss, 2 bits per position
+ */
+
+static const int SIZE = Position::WIDTH * Position::HEIGHT;
+
+struct Layer {
+  vector<Position> positions; // sorted by key()
+  vector<int8_t> scores;
+
+  // score of a position of this layer
+  int score(const Position &P) const {
+    auto it = lower_bound(positions.begin(), positions.end(), P.key(),
+                          [](const Position &a, uint64_t key) {return a.key() < key;});
+    return scores[it - positions.begin()];
+  }
+};
+
+static void dedup(vector<Position> &positions) {
+  sort(positions.begin(), positions.end(), [](const Position &a, const Position &b) {return a.key() < b.key();});
+  positions.erase(unique(positions.begin(), positions.end(), [](const Position &a, const Position &b) {return a.key() == b.key();}),
+                  positions.end());
+}
+
+int main(int argc, char **argv) {
+  int empty_cells = 12;
+  bool wdl = false;
+  vector<string> files;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-e" && i + 1 < argc) empty_cells = stoi(argv[++i]);
+    else if(arg == "-w") wdl = true;
+    else files.push_back(arg);
+  }
+  if(files.size() != 1 || empty_cells < 0 || empty_cells > SIZE) {
+    cerr << "usage: " << argv[0] << " [-e empty_cells] [-w] output_file < roots" << endl;
+    return 1;
+  }
+  const int min_moves = SIZE - empty_cells;
+
+  vector<Layer> layers(SIZE + 1);
+  string line;
+  for(int l = 1; getline(cin, line); l++) {
+    Position P;
+    if(P.play(line) != line.size()) {
+      cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << line << "\"" << endl;
+      return 1;
+    }
+    layers[P.nbMoves()].positions.push_back(P);
+  }
+
+  // forward: every position reachable from the roots, layer by layer
+  int first = SIZE;
+  for(int n = 0; n < SIZE; n++) {
+    vector<Position> &layer = layers[n].positions;
+    if(layer.empty()) continue;
+    first = min(first, n);
+    dedup(layer);
+    for(const Position &P : layer) {
+      if(P.canWinNext()) continue; // the game ends there
+      for(int col = 0; col < Position::WIDTH; col++) {
+        if(!P.canPlay(col)) continue;
+        Position P2(P);
+        P2.playCol(col);
+        layers[n + 1].positions.push_back(P2);
+      }
+    }
+    if(n < min_moves) layer.shrink_to_fit();
+    cerr << "layer " << n << ": " << layer.size() << " positions" << endl;
+  }
+  dedup(layers[SIZE].positions);
+
+  // backward: scores from the full board up to the shallowest stored layer
+  vector<pair<uint64_t, int>> entries;
+  for(int n = SIZE; n >= max(first, min_moves); n--) {
+    Layer &layer = layers[n];
+    layer.scores.resize(layer.positions.size());
+    for(size_t i = 0; i < layer.positions.size(); i++) {
+      const Position &P = layer.positions[i];
+      int score;
+      if(n == SIZE) score = 0;
+      else if(P.canWinNext()) score = (SIZE + 1 - n) / 2;
+      else {
+        score = Position::MIN_SCORE - 1;
+        for(int col = 0; col < Position::WIDTH; col++) {
+          if(!P.canPlay(col)) continue;
+          Position P2(P);
+          P2.playCol(col);
+          score = max(score, -layers[n + 1].score(P2));
+        }
+        if(n < SIZE - 2) entries.emplace_back(CompressedBook::bookKey(P, CompressedBook::POSITION_KEY), score);
+      }
+      layer.scores[i] = int8_t(score);
+    }
+    if(n < SIZE) layers[n + 1] = Layer(); // no longer needed
+  }
+
+  cerr << entries.size() << " positions from " << max(first, min_moves) << " to " << SIZE - 3 << " stones" << endl;
+  const string &output = files[0];
+  if(!CompressedBook::write(output, entries, SIZE - 3, wdl, CompressedBook::POSITION_KEY, min_moves)) {
+    cerr << "Error writing " << output << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -1,75 +1,202 @@
+#include "Position.h"
+#include <cstdio>
 #include <iostream>
-#include <fstream>
-#include <vector>
 #include <string>
-#include <random>
-#include <chrono>
-
-#define sz(a) ((int)(a.size()))
-#define fi first
-#define se second
-#define eb emplace_back
-#define pb push_back
+#include <unordered_set>
 
+using namespace GameSolver::Connect4;
 using namespace std;
 
-typedef long long ll;
-typedef pair<int, int> pii;
-typedef pair<ll, int> pli;
-typedef pair<ll, ll> pll;
+/**
+ * Enumerate the distinct positions reachable from a root, as move sequences
+ * readable by c4solver, e.g. to build training and test sets.
+ *
+ * usage: generator [-d max_moves] [-m min_moves] [-r root_moves] [--shard i/n] [output_file]
+ *
+ * Only legal positions are walked: a sequence stops at a full column or at a
+ * winning move, which ends the game (Position::play would reject the rest).
+ * Transpositions and mirror positions share their key3: each position is written
+ * once, from its canonical parent, the predecessor of smallest key3 among those
+ * reachable from the root (a predecessor takes back a top stone of the last
+ * player). The walk is a tree: nothing is remembered between positions, memory
+ * only grows with the depth, and lines are written as they are found.
+ * Positions with more than max_moves stones (at most 32, the range of key3) are not
+ * expanded, those with fewer than min_moves are expanded but not written.
+ * With --shard i/n only the i-th of n shards (0 <= i < n) is walked: the subtrees
+ * of the positions SHARD_DEPTH stones below the root are split by a hash of their
+ * key3, the fewer positions above are split the same way. n generators give
+ * disjoint files covering every position, to be solved in parallel. The output
+ * goes to stdout by default.
+ */
 
-mt19937_64 rng(chrono::steady_clock::now().time_since_epoch().count());
+static const int MAX_MOVES = 32;
+static const int SHARD_DEPTH = 6;
 
-const ll inf=1e9;
-const ll infl=1e18;
-const int N=2e5+5;
-const int mod=1e9+7;
+static const int COLUMN_BITS = Position::HEIGHT + 1;
+static const uint64_t COLUMN = (UINT64_C(1) << COLUMN_BITS) - 1;
 
-int gen(int lo, int hi)
-{
-    return rng()%(hi-lo+1)+lo;
-}
+static int max_moves = 8;
+static int min_moves = 1;
+static uint64_t shard = 0, nb_shards = 1;
+static int shard_moves = 0; // nbMoves of the positions whose subtree is split between shards
+static unsigned long long written = 0, walked = 0;
+static FILE *output = stdout;
 
-vector<string> a;
+// Bitboards of a position, as in Position: stones of the player to play, all the stones
+struct Board {
+  uint64_t current;
+  uint64_t mask;
+  int moves;
 
-void quay(int p, int n, string &s)
-{
-    if(p == n+1)
-    {
-        a.pb(s);
-        return;
-    }
-    for(int i=1; i<=7; i++)
-    {
-        s += to_string(i);
-        quay(p+1, n, s);
-        s.pop_back();
+  // decode a Position::key(), see Position::fromKey
+  explicit Board(uint64_t key) : current(0), mask(0), moves(0) {
+    for(int col = 0; col < Position::WIDTH; col++) {
+      const uint64_t k = (key >> (col * COLUMN_BITS)) & COLUMN;
+      int h = 0;
+      while((UINT64_C(2) << h) - 1 <= k) h++;
+      mask |= ((UINT64_C(1) << h) - 1) << (col * COLUMN_BITS);
+      moves += h;
     }
+    current = key - mask;
+  }
+
+  Board(uint64_t current, uint64_t mask, int moves) : current(current), mask(mask), moves(moves) {}
+
+  static uint64_t mirror(uint64_t bitboard) {
+    uint64_t m = 0;
+    for(int col = 0; col < Position::WIDTH; col++)
+      m |= ((bitboard >> (col * COLUMN_BITS)) & COLUMN) << ((Position::WIDTH - 1 - col) * COLUMN_BITS);
+    return m;
+  }
+
+  Board mirror() const {
+    return Board(mirror(current), mirror(mask), moves);
+  }
+
+  uint64_t key3() const {
+    return Position(current, mask).key3();
+  }
+};
+
+static Board root(0, 0, 0);
+static unordered_set<uint64_t> dead_ends; // scratch of reachable(), masks with no way to the target
+
+// Can the stones of target missing from mask be played in turn, mask having the stones of root?
+static bool complete(const Board &target, uint64_t mask, int moves) {
+  if(mask == target.mask) return true;
+  if(dead_ends.count(mask)) return false;
+  // the player to play at mask is the one to play in target after an even number of moves
+  const uint64_t player = (target.moves - moves) % 2 == 0 ? target.current : target.current ^ target.mask;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    const uint64_t cell = (mask + (UINT64_C(1) << (col * COLUMN_BITS))) & Position::column_mask(col);
+    if((cell & player) && complete(target, mask | cell, moves + 1)) return true;
+  }
+  dead_ends.insert(mask);
+  return false;
 }
 
-signed main()
-{
-    ios_base::sync_with_stdio(0);
-    cin.tie(0);
-    cout.tie(0);
-
-    for(int t=1; t<=1; t++)
-    {
-        ofstream inp("input.INP");
-
-        int n=8;
-        for(int i=1; i<=n; i++)
-        {
-            string s;
-            quay(1, i, s);
-        }
-        for(auto &s : a)
-        {
-            inp << s << '\n';
-        }
-
-        inp.close();
+/**
+ * Is target reachable from the root? It has no alignment, so neither has any position
+ * on the way: it is reachable if it extends the root and its other stones can be
+ * played column by column in turn.
+ */
+static bool reachable(const Board &target) {
+  if((root.mask & ~target.mask) || target.moves < root.moves) return false;
+  const uint64_t root_player = (target.moves - root.moves) % 2 == 0 ? target.current : target.current ^ target.mask;
+  if((root_player & root.mask) != root.current) return false;
+  const bool result = complete(target, root.mask, root.moves);
+  dead_ends.clear();
+  return result;
+}
+
+/**
+ * Is P, played from Q (a walked position) with col, walked from Q with col? Yes if
+ * no predecessor of smaller key3 than Q is reachable from the root, and if no
+ * smaller column of Q gives the same position (or its mirror).
+ */
+static bool canonical(const Position &Q, int col, const Position &P) {
+  const uint64_t key3 = P.key3();
+  for(int c = 0; c < col; c++) {
+    if(!Q.canPlay(c) || Q.isWinningMove(c)) continue;
+    Position P2(Q);
+    P2.playCol(c);
+    if(P2.key3() == key3) return false;
+  }
+  const uint64_t parent_key3 = Q.key3();
+  const Board board(P.key());
+  const uint64_t last_player = board.current ^ board.mask;
+  for(int c = 0; c < Position::WIDTH; c++) {
+    if(c == col) continue;
+    const uint64_t column = board.mask & Position::column_mask(c);
+    const uint64_t top = column ^ (column >> 1 & column);
+    if(!(top & last_player)) continue; // empty column or a stone of the player to play
+    const Board predecessor(last_player ^ top, board.mask ^ top, board.moves - 1);
+    if(predecessor.key3() < parent_key3 && (reachable(predecessor) || reachable(predecessor.mirror()))) return false;
+  }
+  return true;
+}
+
+static bool inShard(uint64_t key3) {
+  return ((key3 * UINT64_C(0x9E3779B97F4A7C15)) >> 32) % nb_shards == shard;
+}
+
+// moves: sequence leading to P, 1-based columns
+void enumerate(const Position &P, string &moves) {
+  walked++;
+  if(P.nbMoves() <= shard_moves && !inShard(P.key3())) {
+    if(P.nbMoves() == shard_moves) return; // the subtree of another shard
+  } else if(P.nbMoves() >= min_moves) {
+    fputs(moves.c_str(), output);
+    fputc('\n', output);
+    written++;
+  }
+  if(P.nbMoves() >= max_moves) return;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    if(!P.canPlay(col) || P.isWinningMove(col)) continue;
+    Position P2(P);
+    P2.playCol(col);
+    if(!canonical(P, col, P2)) continue;
+    moves.push_back(char('1' + col));
+    enumerate(P2, moves);
+    moves.pop_back();
+  }
+}
+
+int main(int argc, char **argv) {
+  string root_moves;
+  string filename;
+  bool valid = true;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-d" && i + 1 < argc) max_moves = stoi(argv[++i]);
+    else if(arg == "-m" && i + 1 < argc) min_moves = stoi(argv[++i]);
+    else if(arg == "-r" && i + 1 < argc) root_moves = argv[++i];
+    else if(arg == "--shard" && i + 1 < argc) {
+      unsigned long long i_shard, n_shards;
+      valid = sscanf(argv[++i], "%llu/%llu", &i_shard, &n_shards) == 2 && i_shard < n_shards;
+      shard = i_shard;
+      nb_shards = n_shards;
     }
+    else if(filename.empty()) filename = arg;
+    else valid = false;
+  }
+  Position P;
+  if(!valid || max_moves < 0 || max_moves > MAX_MOVES || P.play(root_moves) != root_moves.size()) {
+    cerr << "usage: " << argv[0] << " [-d max_moves (<= " << MAX_MOVES << ")] [-m min_moves] [-r root_moves] [--shard i/n] [output_file]" << endl;
+    return 1;
+  }
+  if(!filename.empty() && !(output = fopen(filename.c_str(), "w"))) {
+    cerr << "Error opening " << filename << endl;
+    return 1;
+  }
 
-    return 0;
-}
\ No newline at end of file
+  root = Board(P.key());
+  shard_moves = nb_shards > 1 ? P.nbMoves() + SHARD_DEPTH : -1;
+  enumerate(P, root_moves);
+  cerr << written << " positions written, " << walked << " walked" << endl;
+  if(fclose(output) != 0) {
+    cerr << "Error writing " << (filename.empty() ? "output" : filename) << endl;
+    return 1;
+  }
+  return 0;
+}
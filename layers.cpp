@@ -0,0 +1,396 @@
+#include "SolverPool.h"
+#include "CompressedBook.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Disk backed, resumable enumeration and solving of every position up to a depth,
+ * for books too large to be built in memory like bookconv -s does.
+ *
+ * usage: layers [-d depth] [-m memory_mb] [-t threads] [-b book] [-s] [-o output_book] workdir
+ *
+ * Positions are handled one layer (number of stones) at a time, as 16 byte records
+ * (key3, key), the position being rebuilt from its key by Position::fromKey.
+ *  - expansion: the children of layer n are generated by Position::play into runs
+ *    of at most memory_mb, each sorted by key3 and deduplicated (mirror positions
+ *    share their key3), then the runs are merged into workdir/layer_<n+1>.bin.
+ *    Games ending on a winning move are not expanded.
+ *  - solving (-s): the records of each layer are split in blocks of BLOCK records,
+ *    solved by the threads of a SolverPool, from the deepest layer up so that the
+ *    shared transposition table is warm. The scores of a block are written to
+ *    workdir/solved_<n>_<block>.bin, one byte per record.
+ *  - output (-o): the solved layers are merged by key3 into a compressed opening
+ *    book (see CompressedBook), streamed into a CompressedBook::Builder.
+ * Every file is written under a temporary name, synced and renamed once complete:
+ * after a crash the same command line resumes from the last complete layer or block.
+ * Like the opening book, positions the player to play can win at once are left out.
+ *   -d depth      deepest layer, at most MAX_DEPTH (key3 must fit on 64 bits)
+ *   -m memory_mb  size of the sorted runs of the expansion (default 1024)
+ *   -t threads    solving threads (default: number of cores)
+ *   -b book       opening book used while solving (default 7x6.book)
+ */
+
+static const int MAX_DEPTH = 32;
+static const size_t BLOCK = 1 << 16;
+static const int8_t NOT_STORED = INT8_MIN; // score of the positions left out of the book
+
+struct Record {
+  uint64_t key3;
+  uint64_t key;
+};
+
+static string workdir;
+
+static string layerFile(int n) {
+  return workdir + "/layer_" + to_string(n) + ".bin";
+}
+
+static string runFile(int n, size_t run) {
+  return workdir + "/run_" + to_string(n) + "_" + to_string(run) + ".bin";
+}
+
+static string solvedFile(int n, size_t block) {
+  return workdir + "/solved_" + to_string(n) + "_" + to_string(block) + ".bin";
+}
+
+static bool exists(const string &filename) {
+  struct stat st;
+  return stat(filename.c_str(), &st) == 0;
+}
+
+// number of records of a layer file
+static size_t layerSize(int n) {
+  struct stat st;
+  return stat(layerFile(n).c_str(), &st) == 0 ? st.st_size / sizeof(Record) : 0;
+}
+
+/**
+ * Write a complete file: under a temporary name, synced, then renamed, so that a
+ * file is either missing or complete after a crash.
+ */
+class AtomicFile {
+ public:
+  explicit AtomicFile(const string &filename) : filename(filename), tmp(filename + ".tmp") {
+    f = fopen(tmp.c_str(), "wb");
+    if(!f) throw runtime_error("cannot create " + tmp);
+  }
+
+  ~AtomicFile() {
+    if(f) fclose(f);
+  }
+
+  void write(const void *data, size_t size, size_t count) {
+    if(fwrite(data, size, count, f) != count) throw runtime_error("cannot write " + tmp);
+  }
+
+  void commit() {
+    bool ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    f = nullptr;
+    if(!ok || rename(tmp.c_str(), filename.c_str()) != 0) throw runtime_error("cannot write " + filename);
+  }
+
+ private:
+  string filename, tmp;
+  FILE *f;
+};
+
+// Sequential reader of a file of records sorted by key3
+class RecordReader {
+ public:
+  explicit RecordReader(const string &filename) : buffer(BLOCK) {
+    f = fopen(filename.c_str(), "rb");
+    if(!f) throw runtime_error("cannot open " + filename);
+    next();
+  }
+
+  ~RecordReader() {
+    fclose(f);
+  }
+
+  bool valid() const {
+    return pos < count;
+  }
+
+  const Record &get() const {
+    return buffer[pos];
+  }
+
+  void next() {
+    if(++pos < count) return;
+    count = fread(buffer.data(), sizeof(Record), buffer.size(), f);
+    pos = 0;
+  }
+
+ private:
+  FILE *f;
+  vector<Record> buffer;
+  size_t pos = 0, count = 0;
+};
+
+static bool byKey3(const Record &a, const Record &b) {
+  return a.key3 < b.key3;
+}
+
+static void sortUnique(vector<Record> &records) {
+  sort(records.begin(), records.end(), byKey3);
+  records.erase(unique(records.begin(), records.end(), [](const Record &a, const Record &b) {return a.key3 == b.key3;}),
+                records.end());
+}
+
+/**
+ * Expand layer n into layer n + 1 with sorted runs of at most run_size records.
+ */
+static void expand(int n, size_t run_size) {
+  vector<Record> run;
+  run.reserve(run_size);
+  size_t runs = 0;
+  auto flush = [&]() {
+    sortUnique(run);
+    AtomicFile out(runFile(n + 1, runs++));
+    out.write(run.data(), sizeof(Record), run.size());
+    out.commit();
+    run.clear();
+  };
+
+  for(RecordReader in(layerFile(n)); in.valid(); in.next()) {
+    const Position P = Position::fromKey(in.get().key);
+    if(P.canWinNext()) continue; // the game ends there
+    for(int col = 0; col < Position::WIDTH; col++) {
+      if(!P.canPlay(col)) continue;
+      Position P2(P);
+      P2.playCol(col);
+      if(run.size() == run_size) flush();
+      run.push_back({P2.key3(), P2.key()});
+    }
+  }
+  if(!run.empty() || runs == 0) flush();
+
+  // k-way merge of the runs, keeping one record per key3
+  vector<unique_ptr<RecordReader>> readers;
+  for(size_t i = 0; i < runs; i++) readers.emplace_back(new RecordReader(runFile(n + 1, i)));
+  auto later = [&](size_t a, size_t b) {return readers[a]->get().key3 > readers[b]->get().key3;};
+  priority_queue<size_t, vector<size_t>, decltype(later)> heap(later);
+  for(size_t i = 0; i < runs; i++)
+    if(readers[i]->valid()) heap.push(i);
+
+  AtomicFile out(layerFile(n + 1));
+  vector<Record> buffer;
+  buffer.reserve(BLOCK);
+  bool first = true;
+  uint64_t last_key3 = 0;
+  while(!heap.empty()) {
+    size_t i = heap.top();
+    heap.pop();
+    const Record &r = readers[i]->get();
+    if(first || r.key3 != last_key3) {
+      if(buffer.size() == BLOCK) {
+        out.write(buffer.data(), sizeof(Record), buffer.size());
+        buffer.clear();
+      }
+      buffer.push_back(r);
+      last_key3 = r.key3;
+      first = false;
+    }
+    readers[i]->next();
+    if(readers[i]->valid()) heap.push(i);
+  }
+  out.write(buffer.data(), sizeof(Record), buffer.size());
+  out.commit();
+  readers.clear();
+  for(size_t i = 0; i < runs; i++) remove(runFile(n + 1, i).c_str());
+}
+
+/**
+ * Solve every block of layer n not solved yet, with the threads of the pool.
+ */
+static void solveLayer(int n, SolverPool &pool, size_t nb_threads) {
+  const size_t size = layerSize(n);
+  const size_t blocks = (size + BLOCK - 1) / BLOCK;
+  atomic<size_t> next_block{0};
+  atomic<unsigned long long> solved{0};
+  vector<string> errors(nb_threads);
+  auto work = [&](size_t thread) {
+    try {
+      FILE *f = fopen(layerFile(n).c_str(), "rb");
+      if(!f) throw runtime_error("cannot open " + layerFile(n));
+      unique_ptr<FILE, int (*)(FILE *)> closer(f, fclose);
+      vector<Record> records(BLOCK);
+      vector<int8_t> scores;
+      for(size_t block; (block = next_block++) < blocks;) {
+        if(exists(solvedFile(n, block))) continue; // solved before a restart
+        if(fseeko(f, off_t(block * BLOCK * sizeof(Record)), SEEK_SET) != 0) throw runtime_error("cannot read " + layerFile(n));
+        records.resize(BLOCK);
+        records.resize(fread(records.data(), sizeof(Record), BLOCK, f));
+        scores.assign(records.size(), NOT_STORED);
+        auto solver = pool.acquire();
+        for(size_t i = 0; i < records.size(); i++) {
+          const Position P = Position::fromKey(records[i].key);
+          if(!P.canWinNext()) scores[i] = int8_t(solver->solve(P));
+        }
+        AtomicFile out(solvedFile(n, block));
+        out.write(scores.data(), 1, scores.size());
+        out.commit();
+        solved += records.size();
+      }
+    } catch(const exception &e) {
+      errors[thread] = e.what();
+    }
+  };
+  vector<thread> threads;
+  for(size_t i = 0; i < nb_threads; i++) threads.emplace_back(work, i);
+  for(auto &t : threads) t.join();
+  for(const string &error : errors)
+    if(!error.empty()) throw runtime_error(error);
+  cerr << "layer " << n << ": " << solved << " positions solved" << endl;
+}
+
+// Sequential reader of a solved layer: records with their score
+class SolvedReader {
+ public:
+  explicit SolvedReader(int n) : n(n), records(layerFile(n)) {
+    load();
+  }
+
+  bool valid() const {
+    return records.valid();
+  }
+
+  const Record &get() const {
+    return records.get();
+  }
+
+  int score() const {
+    return scores[index % BLOCK];
+  }
+
+  // next record in the book, skipping the positions left out
+  void next() {
+    do {
+      records.next();
+      if(++index % BLOCK == 0) load();
+    } while(valid() && score() == NOT_STORED);
+  }
+
+  // skip the first records if they are left out
+  void start() {
+    while(valid() && score() == NOT_STORED) next();
+  }
+
+ private:
+  int n;
+  RecordReader records;
+  size_t index = 0;
+  vector<int8_t> scores;
+
+  void load() {
+    scores.assign(BLOCK, NOT_STORED);
+    if(!valid()) return;
+    const string filename = solvedFile(n, index / BLOCK);
+    FILE *f = fopen(filename.c_str(), "rb");
+    if(!f) throw runtime_error("missing " + filename + ", solve with -s");
+    scores.resize(fread(scores.data(), 1, BLOCK, f));
+    fclose(f);
+  }
+};
+
+/**
+ * Merge the solved layers up to depth into a compressed opening book.
+ * Two passes: the first counts the positions and the largest key, the second adds
+ * them to the builder in key3 order.
+ */
+static void writeBook(const string &output, int depth) {
+  uint64_t count = 0, universe = 1;
+  for(int n = 0; n <= depth; n++) {
+    SolvedReader in(n);
+    for(in.start(); in.valid(); in.next()) {
+      count++;
+      universe = max(universe, in.get().key3 + 1);
+    }
+  }
+
+  CompressedBook::Builder builder(count, universe, false);
+  vector<unique_ptr<SolvedReader>> readers;
+  for(int n = 0; n <= depth; n++) {
+    readers.emplace_back(new SolvedReader(n));
+    readers.back()->start();
+  }
+  auto later = [&](int a, int b) {return readers[a]->get().key3 > readers[b]->get().key3;};
+  priority_queue<int, vector<int>, decltype(later)> heap(later);
+  for(int n = 0; n <= depth; n++)
+    if(readers[n]->valid()) heap.push(n);
+  while(!heap.empty()) {
+    int n = heap.top();
+    heap.pop();
+    builder.add(readers[n]->get().key3, readers[n]->score()); // layers never share a key3
+    readers[n]->next();
+    if(readers[n]->valid()) heap.push(n);
+  }
+  if(!builder.write(output, depth)) throw runtime_error("cannot write " + output);
+  cerr << count << " positions written to " << output << endl;
+}
+
+int main(int argc, char **argv) {
+  int depth = 12;
+  size_t memory_mb = 1024;
+  size_t nb_threads = max(1u, thread::hardware_concurrency());
+  string book = "7x6.book";
+  string output;
+  bool solve = false;
+  vector<string> files;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-d" && i + 1 < argc) depth = stoi(argv[++i]);
+    else if(arg == "-m" && i + 1 < argc) memory_mb = stoul(argv[++i]);
+    else if(arg == "-t" && i + 1 < argc) nb_threads = stoul(argv[++i]);
+    else if(arg == "-b" && i + 1 < argc) book = argv[++i];
+    else if(arg == "-o" && i + 1 < argc) output = argv[++i];
+    else if(arg == "-s") solve = true;
+    else files.push_back(arg);
+  }
+  if(files.size() != 1 || depth < 0 || depth > MAX_DEPTH || memory_mb == 0 || nb_threads == 0) {
+    cerr << "usage: " << argv[0] << " [-d depth (<= " << MAX_DEPTH << ")] [-m memory_mb] [-t threads] [-b book] [-s] [-o output_book] workdir" << endl;
+    return 1;
+  }
+  workdir = files[0];
+  mkdir(workdir.c_str(), 0755);
+
+  try {
+    if(!exists(layerFile(0))) {
+      const Position P;
+      const Record root{P.key3(), P.key()};
+      AtomicFile out(layerFile(0));
+      out.write(&root, sizeof(root), 1);
+      out.commit();
+    }
+    const size_t run_size = max<size_t>(memory_mb * (1 << 20) / sizeof(Record), BLOCK);
+    for(int n = 0; n < depth; n++) {
+      if(exists(layerFile(n + 1))) continue; // expanded before a restart
+      expand(n, run_size);
+      cerr << "layer " << n + 1 << ": " << layerSize(n + 1) << " positions" << endl;
+    }
+
+    if(solve) {
+      SolverPool pool(nb_threads);
+      pool.loadBook(book);
+      for(int n = depth; n >= 0; n--) solveLayer(n, pool, nb_threads);
+    }
+    if(!output.empty()) writeBook(output, depth);
+  } catch(const exception &e) {
+    cerr << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,319 @@
+#include "httplib.h"
+#include "json.h"
+#include "Board.h"
+#include "Position.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using json = nlohmann::json;
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Load generator for the move API of a server running on this machine: plays game
+ * sessions over HTTP with the real client stack, and reports throughput, latency
+ * percentiles and errors.
+ *
+ * usage: loadtest [-p port] [-c concurrency] [-r rate] [-n sessions] [-t seconds] [-s seed] [-w] [-o record_file] [session_file]
+ *
+ * A session is a sequence of POST /api/connect4-move bodies sent one after the other
+ * on a keep-alive connection, like a client playing a game.
+ *  - session_file: recorded sessions, one request body per line, sessions separated
+ *    by an empty line. They are replayed verbatim, in a loop if -n asks for more.
+ *    A line starting with a move sequence (1-based columns, as written by generator
+ *    or sampler) stands for the request of the position it reaches; a sequence that
+ *    does not extend the one of the previous line also starts a new session.
+ *  - without session_file: synthetic games. The server plays first in even sessions,
+ *    second in odd ones; the client answers with a random non losing move, drawn from
+ *    a generator seeded by the seed and the session number. The requests also depend
+ *    on the moves of the server: they repeat with -c 1 against a server freshly
+ *    started with RANDOM_SEED. -o records the synthetic sessions, whose replays send
+ *    exactly the same requests whatever the concurrency.
+ * The concurrency is the number of sessions played at once, each on its own
+ * connection. With a rate (requests per second, all connections together) requests
+ * are sent on a fixed schedule and latency counts from the scheduled time, so that
+ * a stalled server is not hidden by clients waiting for it; otherwise each
+ * connection sends its next request as soon as it gets an answer.
+ * An error is a failed connection, a status other than 200 or an unplayable move.
+ * Only 127.0.0.1 is targeted.
+ *   -p port         server port (default 8080)
+ *   -c concurrency  simultaneous sessions (default 4)
+ *   -r rate         requests per second (default: as fast as possible)
+ *   -n sessions     number of sessions (default 100, or the number of recorded ones)
+ *   -t seconds      stop starting requests after this time
+ *   -w              synthetic requests use the weak solver
+ */
+
+typedef chrono::steady_clock Clock;
+
+struct Options {
+  int port = 8080;
+  int concurrency = 4;
+  double rate = 0;
+  long long sessions = -1;
+  double seconds = 0;
+  unsigned long long seed = 1;
+  bool weak = false;
+};
+
+struct Stats {
+  vector<double> latencies; // seconds
+  unsigned long long requests = 0;
+  unsigned long long failures = 0;    // connection or read error
+  unsigned long long http_errors = 0; // status other than 200
+  unsigned long long bad_moves = 0;   // move missing or not playable
+};
+
+// Request body of the move API for a board, player to play: current_player
+static string moveRequest(const Board &board, int current_player, bool is_new_game, bool weak) {
+  json request;
+  request["board"] = json::array();
+  for(int row = 0; row < Position::HEIGHT; row++) {
+    json cells = json::array();
+    for(int col = 0; col < Position::WIDTH; col++) cells.push_back(board.get(row, col));
+    request["board"].push_back(cells);
+  }
+  request["current_player"] = current_player;
+  json valid_moves = json::array();
+  for(int col = 0; col < Position::WIDTH; col++)
+    if(board.get(0, col) == 0) valid_moves.push_back(col);
+  request["valid_moves"] = valid_moves;
+  request["is_new_game"] = is_new_game;
+  if(weak) request["weak"] = true;
+  return request.dump();
+}
+
+/**
+ * Read recorded sessions: one body or move sequence per line, an empty line ends a session.
+ * @return false if the file cannot be read or has an invalid move sequence.
+ */
+static bool readSessions(const string &filename, vector<vector<string>> &sessions) {
+  ifstream in(filename);
+  if(!in) return false;
+  sessions.assign(1, vector<string>());
+  string line, previous_moves;
+  for(int l = 1; getline(in, line); l++) {
+    if(!line.empty() && line.back() == '\r') line.pop_back();
+    if(line.empty()) {
+      if(!sessions.back().empty()) sessions.emplace_back();
+      previous_moves.clear();
+    } else if(line[0] == '{') {
+      sessions.back().push_back(line);
+      previous_moves.clear();
+    } else {
+      const string moves = line.substr(0, line.find(' '));
+      if(!sessions.back().empty() && moves.compare(0, previous_moves.size(), previous_moves) != 0) sessions.emplace_back();
+      previous_moves = moves;
+      Board board;
+      Position P;
+      if(P.play(moves) != moves.size()) {
+        cerr << "Line " << l << ": Invalid move " << (P.nbMoves() + 1) << " \"" << moves << "\"" << endl;
+        return false;
+      }
+      for(size_t i = 0; i < moves.size(); i++) board.play(moves[i] - '1', i % 2 + 1);
+      sessions.back().push_back(moveRequest(board, moves.size() % 2 + 1, sessions.back().empty(), false));
+    }
+  }
+  if(sessions.back().empty()) sessions.pop_back();
+  return true;
+}
+
+class LoadTest {
+ public:
+  LoadTest(const Options &options, const vector<vector<string>> &recorded) :
+    options(options), recorded(recorded) {}
+
+  // Play all the sessions, optionally recording the synthetic ones
+  Stats run(ostream *record) {
+    this->record = record;
+    start = Clock::now();
+    vector<Stats> stats(options.concurrency);
+    vector<thread> threads;
+    for(int i = 0; i < options.concurrency; i++) threads.emplace_back([this, &stats, i] {worker(stats[i]);});
+    for(auto &t : threads) t.join();
+    elapsed = chrono::duration<double>(Clock::now() - start).count();
+
+    Stats total;
+    for(const Stats &s : stats) {
+      total.latencies.insert(total.latencies.end(), s.latencies.begin(), s.latencies.end());
+      total.requests += s.requests;
+      total.failures += s.failures;
+      total.http_errors += s.http_errors;
+      total.bad_moves += s.bad_moves;
+    }
+    return total;
+  }
+
+  double getElapsed() const {
+    return elapsed;
+  }
+
+ private:
+  const Options &options;
+  const vector<vector<string>> &recorded;
+  ostream *record = nullptr;
+  mutex record_mutex;
+  Clock::time_point start;
+  double elapsed = 0;
+  atomic<long long> next_session{0};
+  atomic<unsigned long long> next_ticket{0}; // rank of the next request in the schedule
+  atomic<bool> stopped{false};
+
+  bool timeUp() {
+    if(options.seconds > 0 && Clock::now() - start >= chrono::duration<double>(options.seconds)) stopped = true;
+    return stopped;
+  }
+
+  /**
+   * Send one request, waiting for its turn in the schedule if there is a rate.
+   * @return the move of the answer, -1 on error (counted in stats).
+   */
+  int send(httplib::Client &client, const string &body, Stats &stats) {
+    Clock::time_point sent = Clock::now();
+    if(options.rate > 0) {
+      sent = start + chrono::duration_cast<Clock::duration>(chrono::duration<double>(next_ticket++ / options.rate));
+      this_thread::sleep_until(sent);
+    }
+    auto res = client.Post("/api/connect4-move", body, "application/json");
+    stats.latencies.push_back(chrono::duration<double>(Clock::now() - sent).count());
+    stats.requests++;
+    if(!res) {
+      stats.failures++;
+      return -1;
+    }
+    if(res->status != 200) {
+      stats.http_errors++;
+      return -1;
+    }
+    json answer = json::parse(res->body, nullptr, false);
+    if(answer.is_discarded() || !answer.contains("move") || !answer["move"].is_number_integer()) {
+      stats.bad_moves++;
+      return -1;
+    }
+    return answer["move"].get<int>();
+  }
+
+  void replay(httplib::Client &client, const vector<string> &bodies, Stats &stats) {
+    for(const string &body : bodies) {
+      if(timeUp()) return;
+      send(client, body, stats);
+    }
+  }
+
+  // A synthetic game against the server, the client playing random non losing moves
+  void play(httplib::Client &client, long long session, Stats &stats) {
+    mt19937_64 rng(options.seed * 1000003 + session);
+    const int server = session % 2 ? 2 : 1;
+    Board board;
+    Position P; // position of the game, for the client moves
+    int player = 1;
+    vector<string> bodies;
+    while(!board.isGameOver() && !timeUp()) {
+      int col;
+      if(player == server) {
+        bodies.push_back(moveRequest(board, player, bodies.empty(), options.weak));
+        col = send(client, bodies.back(), stats);
+        if(col < 0) break;
+        if(col >= Position::WIDTH || !P.canPlay(col)) {
+          stats.bad_moves++;
+          break;
+        }
+      } else {
+        // win at once if possible, else a random non losing move, else any move
+        const bool can_win = P.canWinNext();
+        const uint64_t candidates = can_win ? 0 : P.possibleNonLosingMoves();
+        int columns[Position::WIDTH], nb_columns = 0;
+        for(int c = 0; c < Position::WIDTH; c++)
+          if(can_win ? P.isWinningMove(c) : P.canPlay(c) && (!candidates || candidates & Position::column_mask(c)))
+            columns[nb_columns++] = c;
+        col = columns[rng() % nb_columns];
+      }
+      board.play(col, player);
+      P = board.toPosition(3 - player); // Position cannot play past an alignment, the board can
+      player = 3 - player;
+    }
+    if(record && !bodies.empty()) {
+      lock_guard<mutex> lock(record_mutex);
+      for(const string &body : bodies) *record << body << '\n';
+      *record << '\n';
+    }
+  }
+
+  void worker(Stats &stats) {
+    httplib::Client client("127.0.0.1", options.port);
+    client.set_keep_alive(true);
+    client.set_tcp_nodelay(true); // headers and body are separate writes: no Nagle delay on the body
+    client.set_read_timeout(300);
+    for(long long session; (session = next_session++) < options.sessions && !timeUp();) {
+      if(recorded.empty()) play(client, session, stats);
+      else replay(client, recorded[session % recorded.size()], stats);
+    }
+  }
+};
+
+int main(int argc, char **argv) {
+  Options options;
+  string session_file, record_file;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-p" && i + 1 < argc) options.port = stoi(argv[++i]);
+    else if(arg == "-c" && i + 1 < argc) options.concurrency = stoi(argv[++i]);
+    else if(arg == "-r" && i + 1 < argc) options.rate = stod(argv[++i]);
+    else if(arg == "-n" && i + 1 < argc) options.sessions = stoll(argv[++i]);
+    else if(arg == "-t" && i + 1 < argc) options.seconds = stod(argv[++i]);
+    else if(arg == "-s" && i + 1 < argc) options.seed = stoull(argv[++i]);
+    else if(arg == "-o" && i + 1 < argc) record_file = argv[++i];
+    else if(arg == "-w") options.weak = true;
+    else if(session_file.empty() && arg[0] != '-') session_file = arg;
+    else options.concurrency = 0; // usage
+  }
+  if(options.concurrency <= 0 || options.rate < 0 || options.port <= 0) {
+    cerr << "usage: " << argv[0] << " [-p port] [-c concurrency] [-r rate] [-n sessions] [-t seconds] [-s seed] [-w] [-o record_file] [session_file]" << endl;
+    return 1;
+  }
+
+  vector<vector<string>> recorded;
+  if(!session_file.empty()) {
+    if(!readSessions(session_file, recorded) || recorded.empty()) {
+      cerr << "No session in " << session_file << endl;
+      return 1;
+    }
+    if(options.sessions < 0) options.sessions = recorded.size();
+  }
+  else if(options.sessions < 0) options.sessions = 100;
+  ofstream record;
+  if(!record_file.empty()) {
+    record.open(record_file);
+    if(!record) {
+      cerr << "Error opening " << record_file << endl;
+      return 1;
+    }
+  }
+
+  LoadTest test(options, recorded);
+  Stats stats = test.run(record_file.empty() || !recorded.empty() ? nullptr : &record);
+
+  const double elapsed = test.getElapsed();
+  const unsigned long long errors = stats.failures + stats.http_errors + stats.bad_moves;
+  sort(stats.latencies.begin(), stats.latencies.end());
+  auto percentile = [&](double q) {
+    if(stats.latencies.empty()) return 0.0;
+    size_t i = min(stats.latencies.size() - 1, size_t(q * stats.latencies.size()));
+    return stats.latencies[i] * 1e3;
+  };
+  printf("requests %llu in %.2f s, %.1f req/s\n", stats.requests, elapsed, elapsed > 0 ? stats.requests / elapsed : 0.0);
+  printf("errors %llu (%.2f%%): %llu failed, %llu http, %llu bad moves\n", errors,
+         stats.requests ? 100.0 * errors / stats.requests : 0.0, stats.failures, stats.http_errors, stats.bad_moves);
+  printf("latency ms: p50 %.3f p99 %.3f p999 %.3f max %.3f\n", percentile(0.5), percentile(0.99), percentile(0.999),
+         stats.latencies.empty() ? 0.0 : stats.latencies.back() * 1e3);
+  return errors ? 2 : 0;
+}
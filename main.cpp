@@ -6,13 +6,30 @@
 using namespace GameSolver::Connect4;
 using namespace std;
 
+/**
+ * usage: c4solver [-w] [-b book]...
+ * Reads one move sequence per line and prints the score of each column.
+ *   -w       weak solver: only tell win (1), draw (0) or loss (-1)
+ *   -b book  load this book instead of 7x6.book; a win/draw/loss compressed book
+ *            (bookconv -w) or an endgame table (endgame) is used in addition to the exact one
+ */
 int main(int argc, char** argv) {
   Solver solver;
   bool weak = false;
   bool analyze = true;
 
-  string opening_book = "7x6.book";
-  solver.loadBook(opening_book);
+  vector<string> books;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-w") weak = true;
+    else if(arg == "-b" && i + 1 < argc) books.push_back(argv[++i]);
+    else {
+      cerr << "usage: " << argv[0] << " [-w] [-b book]..." << endl;
+      return 1;
+    }
+  }
+  if(books.empty()) books.push_back("7x6.book");
+  for(const string &book : books) solver.loadBook(book);
 
   string line;
 
@@ -0,0 +1,51 @@
+#include "BinaryProtocol.h"
+#include <cstdio>
+
+using namespace GameSolver::Connect4;
+
+/**
+ * Checks of the position validation of the binary protocol: the bitboards come
+ * from untrusted clients and must never reach the solver as a corrupt Position.
+ *
+ * usage: protocol_test (run by make test, exits with 1 on a failure)
+ */
+
+static int failures = 0;
+
+static void check(const char *name, uint64_t current_position, uint64_t mask, bool expected) {
+  BinaryProtocol::Request request;
+  request.current_position = current_position;
+  request.mask = mask;
+  if(request.isValidPosition() != expected) {
+    printf("FAIL %s: current_position=%#llx mask=%#llx should be %s\n", name,
+           (unsigned long long)current_position, (unsigned long long)mask, expected ? "valid" : "rejected");
+    failures++;
+  }
+}
+
+int main() {
+  const int column_bits = Position::HEIGHT + 1;
+  const uint64_t full_column = (UINT64_C(1) << Position::HEIGHT) - 1;             // playable cells of column 0
+  const uint64_t sentinel_column = (UINT64_C(1) << column_bits) - 1;             // and the sentinel cell
+  const uint64_t alternating = sentinel_column & UINT64_C(0xAAAAAAAAAAAAAAAA);   // every other stone, from the second
+
+  check("empty board", 0, 0, true);
+  check("opponent played once", 0, 1, true);
+  check("one stone each", 2, 3, true);
+  check("full column", alternating & full_column, full_column, true);
+
+  check("stone of the player outside the mask", 2, 1, false);
+  check("floating stone", 0, 2, false);
+  check("sentinel row of column 0", alternating, sentinel_column, false);
+  const int last = (Position::WIDTH - 1) * column_bits;
+  check("sentinel row of the last column", alternating << last, sentinel_column << last, false);
+  check("bits above the last column", 0, UINT64_C(1) << (Position::WIDTH * column_bits), false);
+  check("player to play has one more stone", 3, 7, false);
+  check("opponent has two more stones", 0, 3, false);
+  const uint64_t three_in_column_1 = UINT64_C(7) << column_bits;
+  check("opponent has four in a column", three_in_column_1, 0xF | three_in_column_1, false);
+
+  if(failures) return 1;
+  printf("all checks passed\n");
+  return 0;
+}
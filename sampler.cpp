@@ -0,0 +1,111 @@
+#include "Solver.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_set>
+
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Write a benchmark file of random positions with their expected score, reproducible
+ * from a seed, e.g. to compare the speed of two builds on the same load.
+ *
+ * usage: sampler [-s seed] [-n count] [-m moves] [-l min_nodes] [-u max_nodes] [-b book] [-w] output_file
+ *
+ * Positions are reached from the empty board by playing random non losing moves
+ * (Position::possibleNonLosingMoves), so that both players make plausible games.
+ * A game ending early, or a position the player to play can win at once, is
+ * dropped and a new game starts. Each position is then solved from an empty
+ * transposition table: it is kept if the search took between min_nodes and
+ * max_nodes nodes, the difficulty band, and if it is not a duplicate.
+ * Output lines are "moves score", moves as read by c4solver, score as returned by
+ * Solver::solve (the sign only with -w). The same seed, band and book give the
+ * same file; without the book much harder positions fall in the same band.
+ * The sampler gives up after MAX_GAMES_PER_POSITION games per position asked for,
+ * when the band is too narrow for the number of stones.
+ *   -s seed       random seed (default 1)
+ *   -n count      number of positions (default 1000)
+ *   -m moves      number of stones of the positions (default 16)
+ *   -l, -u        difficulty band in searched nodes (default any)
+ *   -b book       opening book (default 7x6.book)
+ *   -w            weak solver: win/draw/loss scores, nodes of the weak search
+ */
+
+static const int SIZE = Position::WIDTH * Position::HEIGHT;
+static const unsigned long long MAX_GAMES_PER_POSITION = 1000;
+
+int main(int argc, char **argv) {
+  unsigned long long seed = 1;
+  long long count = 1000;
+  int moves = 16;
+  unsigned long long min_nodes = 0, max_nodes = ~0ULL;
+  string book = "7x6.book";
+  bool weak = false;
+  string output;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-s" && i + 1 < argc) seed = stoull(argv[++i]);
+    else if(arg == "-n" && i + 1 < argc) count = stoll(argv[++i]);
+    else if(arg == "-m" && i + 1 < argc) moves = stoi(argv[++i]);
+    else if(arg == "-l" && i + 1 < argc) min_nodes = stoull(argv[++i]);
+    else if(arg == "-u" && i + 1 < argc) max_nodes = stoull(argv[++i]);
+    else if(arg == "-b" && i + 1 < argc) book = argv[++i];
+    else if(arg == "-w") weak = true;
+    else output = arg;
+  }
+  if(output.empty() || count < 0 || moves < 0 || moves >= SIZE || min_nodes > max_nodes) {
+    cerr << "usage: " << argv[0] << " [-s seed] [-n count] [-m moves] [-l min_nodes] [-u max_nodes] [-b book] [-w] output_file" << endl;
+    return 1;
+  }
+
+  Solver solver;
+  solver.loadBook(book);
+  mt19937_64 rng(seed);
+  unordered_set<uint64_t> seen; // positions already tried, kept or not: key of the position or its mirror,
+                                // exact at any depth unlike key3
+  FILE *f = fopen(output.c_str(), "w");
+  if(!f) {
+    cerr << "Error opening " << output << endl;
+    return 1;
+  }
+
+  long long kept = 0;
+  unsigned long long games = 0, too_easy = 0, too_hard = 0;
+  while(kept < count && games < MAX_GAMES_PER_POSITION * count) {
+    games++;
+    Position P;
+    string sequence;
+    while(P.nbMoves() < moves && !P.canWinNext()) {
+      const uint64_t candidates = P.possibleNonLosingMoves();
+      int nb_candidates = 0;
+      int columns[Position::WIDTH];
+      for(int col = 0; col < Position::WIDTH; col++)
+        if(candidates & Position::column_mask(col)) columns[nb_candidates++] = col;
+      if(nb_candidates == 0) break; // lost, or a full board
+      const int col = columns[rng() % nb_candidates];
+      P.playCol(col);
+      sequence += char('1' + col);
+    }
+    if(P.nbMoves() < moves || P.canWinNext() || !seen.insert(min(P.key(), P.mirrorKey())).second) continue;
+
+    solver.reset(); // also the node counter
+    const int score = solver.solve(P, weak);
+    const unsigned long long nodes = solver.getNodeCount();
+    if(nodes < min_nodes) too_easy++;
+    else if(nodes > max_nodes) too_hard++;
+    else {
+      fprintf(f, "%s %d\n", sequence.c_str(), score);
+      if(++kept % 100 == 0) cerr << kept << " positions" << endl;
+    }
+  }
+  cerr << kept << " positions from " << games << " games, " << too_easy << " too easy, " << too_hard << " too hard" << endl;
+  if(kept < count) cerr << "Difficulty band too narrow, only " << kept << " positions found" << endl;
+  if(fclose(f) != 0) {
+    cerr << "Error writing " << output << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -3,6 +3,16 @@
 #include "Position.h"
 #include "Solver.h"
 #include "OpeningBook.h"
+#include "Metrics.h"
+#include "Logger.h"
+#include "Tactics.h"
+#include "Board.h"
+#include "MoveRequest.h"
+#include "SolverPool.h"
+#include "SingleFlight.h"
+#include "Ponderer.h"
+#include "StrategyTable.h"
+#include "AsyncServer.h"
 #include <iostream>
 #include <vector>
 #include <string>
@@ -11,236 +21,631 @@
 #include <algorithm>
 #include <sstream>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
 #include <random>
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <condition_variable>
 
 using json = nlohmann::json;
 using namespace GameSolver::Connect4;
 
+// Số solver chạy song song, mặc định bằng số nhân CPU (SOLVER_THREADS)
+size_t solver_threads() {
+    const char* threads = std::getenv("SOLVER_THREADS");
+    if(threads) return std::max(1, std::atoi(threads));
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Bảng chuyển vị: TT_LOG_SIZE cho bảng chung, TT_LOCAL_LOG_SIZE cho bảng riêng của mỗi solver
+// (0 = không dùng), TT_SHARED_MIN_WORK: chỉ ghi vào bảng chung các kết quả đủ tốn kém
+SolverPool::Options solver_pool_options() {
+    SolverPool::Options options;
+    if(const char* log_size = std::getenv("TT_LOG_SIZE")) options.shared_log_size = std::atoi(log_size);
+    if(const char* local_log_size = std::getenv("TT_LOCAL_LOG_SIZE")) options.local_log_size = std::atoi(local_log_size);
+    if(const char* min_work = std::getenv("TT_SHARED_MIN_WORK")) options.shared_min_work = std::atoi(min_work);
+    return options;
+}
+
+// Hạt giống cho việc chọn ngẫu nhiên giữa các nước tốt nhất (RANDOM_SEED), để tải thử lặp lại được
+unsigned random_seed() {
+    if(const char* seed = std::getenv("RANDOM_SEED")) return unsigned(std::strtoul(seed, nullptr, 10));
+    return std::random_device{}();
+}
+
 // Global state như Python
-Solver solver;
+Logger logger;
+SolverPool solvers(solver_threads(), solver_pool_options());
+SingleFlight analyses; // gộp các phân tích trùng vị trí đang chạy song song
+Ponderer ponderer;     // tìm trước các nước trả lời của đối thủ khi rảnh (PONDER=1)
+StrategyTable strategy; // nước đi tính sẵn cho người đi trước (STRATEGY_FILE)
+std::mutex game_mutex; // protects the game state below, one move request at a time
 Position position;
 std::string move_sequence = "";
-std::vector<std::vector<int>> previous_board;
-
-// Khởi tạo previous_board
-void init_previous_board() {
-    previous_board = std::vector<std::vector<int>>(6, std::vector<int>(7, 0));
+Board previous_board;
+int previous_score = Solver::NO_GUESS; // điểm của nước đi trước, dùng làm dự đoán cho lần tìm kiếm sau
+int principal_variation[Position::WIDTH * Position::HEIGHT]; // diễn biến dự kiến, bắt đầu bằng nước vừa đi
+int pv_length = 0;
+Position pv_expected; // position after the opponent reply predicted by the principal variation
+
+// Front end epoll cho ASYNC_PORT và BINARY_LISTEN, mỗi solver một worker
+AsyncServer::Options async_options() {
+    AsyncServer::Options options;
+    options.workers = solvers.size();
+    return options;
+}
+AsyncServer async_server(async_options());
+
+// Telemetry exposed on /metrics
+Counter requests_total;
+Counter request_errors_total;
+Counter binary_requests_total;
+Counter nodes_searched_total;
+Counter book_hits_total;
+Counter tactical_hits_total;
+Counter json_fallback_total;
+Counter ponder_hits_total;
+Counter strategy_hits_total;
+Counter tt_probes_total;
+Counter tt_local_hits_total;
+Counter tt_shared_hits_total;
+Histogram request_duration{0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+Histogram solve_duration{0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30};
+Gauge nodes_per_second;
+Gauge active_sessions;
+Gauge queue_depth;
+Gauge inflight_requests;
+
+std::string render_metrics() {
+    std::ostringstream out;
+    renderMetric(out, "connect4_requests_total", "Move requests received.", requests_total);
+    renderMetric(out, "connect4_request_errors_total", "Move requests answered with an error.", request_errors_total);
+    renderMetric(out, "connect4_binary_requests_total", "Requests received on the binary protocol listener.", binary_requests_total);
+    renderMetric(out, "connect4_request_duration_seconds", "End to end move request handling time.", request_duration);
+    renderMetric(out, "connect4_solve_duration_seconds", "Time spent in Solver::analyze per request.", solve_duration);
+    renderMetric(out, "connect4_nodes_searched_total", "Negamax nodes explored by the solver.", nodes_searched_total);
+    renderMetric(out, "connect4_nodes_per_second", "Search speed of the last analysis.", nodes_per_second);
+    renderMetric(out, "connect4_book_hits_total", "Positions answered by the opening book during search.", book_hits_total);
+    renderMetric(out, "connect4_tactical_hits_total", "Moves answered by the tactical pre-pass without search.", tactical_hits_total);
+    Counter coalesced;
+    coalesced.inc(analyses.getSharedCount());
+    renderMetric(out, "connect4_coalesced_analyses_total", "Analyses answered by an identical search already in flight.", coalesced);
+    renderMetric(out, "connect4_strategy_hits_total", "Moves answered by the precomputed strategy table.", strategy_hits_total);
+    renderMetric(out, "connect4_ponder_hits_total", "Moves answered from a position analyzed while pondering.", ponder_hits_total);
+    Counter pondered;
+    pondered.inc(ponderer.getCompletedCount());
+    renderMetric(out, "connect4_pondered_positions_total", "Positions analyzed in the background while waiting for the opponent.", pondered);
+    renderMetric(out, "connect4_json_fallback_total", "Move requests the fixed schema parser rejected, parsed with nlohmann instead.", json_fallback_total);
+    renderMetric(out, "connect4_tt_probes_total", "Transposition table lookups during search.", tt_probes_total);
+    renderMetric(out, "connect4_tt_local_hits_total", "Lookups answered by the per solver local table (TT_LOCAL_LOG_SIZE).", tt_local_hits_total);
+    renderMetric(out, "connect4_tt_shared_hits_total", "Lookups answered by the shared table.", tt_shared_hits_total);
+    Gauge tt_fill;
+    tt_fill.set(solvers.getTableFillRatio());
+    renderMetric(out, "connect4_tt_fill_ratio", "Estimated proportion of used transposition table slots.", tt_fill);
+    renderMetric(out, "connect4_active_sessions", "Games currently in progress.", active_sessions);
+    renderMetric(out, "connect4_inflight_requests", "Move requests accepted and not yet answered.", inflight_requests);
+    queue_depth.set(solvers.getWaiting());
+    renderMetric(out, "connect4_queue_depth", "Searches waiting for a free solver.", queue_depth);
+    Gauge async_connections;
+    async_connections.set(async_server.getConnections());
+    renderMetric(out, "connect4_async_connections", "Open connections on the async front end.", async_connections);
+    Gauge async_queued;
+    async_queued.set(async_server.getQueued());
+    renderMetric(out, "connect4_async_queued_jobs", "Async front end requests waiting for a worker.", async_queued);
+    Counter log_dropped;
+    log_dropped.inc(logger.getDropped());
+    renderMetric(out, "connect4_log_dropped_total", "Log lines dropped because the log ring buffer was full.", log_dropped);
+    return out.str();
 }
 
 // Reset state
 void reset_state() {
     position = Position();
-    move_sequence = "";
-    init_previous_board();
-    std::cout << "State reset" << std::endl;
+    move_sequence.clear();
+    previous_board = Board();
+    previous_score = Solver::NO_GUESS;
+    pv_length = 0;
+    active_sessions.set(0);
+    ponderer.cancel();
+    logger.debug("state_reset");
 }
 
-// Kiểm tra game over
-bool is_game_over(const std::vector<std::vector<int>>& board) {
-    // Check full board (draw)
-    bool is_full = true;
-    for(const auto& row : board) {
-        for(int cell : row) {
-            if(cell == 0) {
-                is_full = false;
-                break;
-            }
-        }
-        if(!is_full) break;
-    }
-    if(is_full) return true;
-
-    // Check for 4 in a row
-    int height = board.size();
-    int width = board[0].size();
-
-    for(int r = 0; r < height; r++) {
-        for(int c = 0; c < width; c++) {
-            if(board[r][c] == 0) continue;
-            int player = board[r][c];
-
-            // Check right
-            if(c <= width - 4) {
-                bool win = true;
-                for(int i = 0; i < 4; i++) {
-                    if(board[r][c+i] != player) {
-                        win = false;
-                        break;
-                    }
-                }
-                if(win) return true;
-            }
-
-            // Check down
-            if(r <= height - 4) {
-                bool win = true;
-                for(int i = 0; i < 4; i++) {
-                    if(board[r+i][c] != player) {
-                        win = false;
-                        break;
-                    }
-                }
-                if(win) return true;
-            }
-
-            // Diagonal down-right
-            if(r <= height - 4 && c <= width - 4) {
-                bool win = true;
-                for(int i = 0; i < 4; i++) {
-                    if(board[r+i][c+i] != player) {
-                        win = false;
-                        break;
-                    }
-                }
-                if(win) return true;
-            }
+// Debug: In ra trạng thái bàn cờ
+void printBoard(const Board& board) {
+    if(!logger.enabled(Logger::Debug)) return;
+    char text[Position::HEIGHT * (Position::WIDTH + 1)];
+    board.toString(text);
+    logger.debug("board", "board=%s", text);
+}
 
-            // Diagonal up-right
-            if(r >= 3 && c <= width - 4) {
-                bool win = true;
-                for(int i = 0; i < 4; i++) {
-                    if(board[r-i][c+i] != player) {
-                        win = false;
-                        break;
-                    }
-                }
-                if(win) return true;
-            }
+// Đọc request bằng nlohmann: chậm hơn MoveRequestParser nhưng chấp nhận mọi JSON hợp lệ
+// và đưa ra thông báo lỗi chính xác.
+Board decode_board(const json& rows) {
+    Board board;
+    if(!rows.is_array() || rows.size() != Position::HEIGHT) throw std::runtime_error("board must have 6 rows");
+    for(int row = 0; row < Position::HEIGHT; row++) {
+        const json& cells = rows[row];
+        if(!cells.is_array() || cells.size() != Position::WIDTH) throw std::runtime_error("board rows must have 7 cells");
+        for(int col = 0; col < Position::WIDTH; col++) {
+            if(!board.set(row, col, cells[col].get<int>())) throw std::runtime_error("invalid board cell");
         }
     }
-    return false;
+    return board;
 }
 
-// Debug: In ra trạng thái bàn cờ
-void printBoard(const std::vector<std::vector<int>>& board) {
-    std::cout << "\nBoard state:" << std::endl;
-    for(int row = 0; row < 6; row++) {
-        std::cout << "|";
-        for(int col = 0; col < 7; col++) {
-            if(board[row][col] == 0) std::cout << " ";
-            else if(board[row][col] == 1) std::cout << "X";
-            else std::cout << "O";
-            std::cout << "|";
-        }
-        std::cout << std::endl;
+MoveRequest decode_move_request(const json& data) {
+    MoveRequest request;
+    request.board = decode_board(data.at("board"));
+    request.current_player = data.at("current_player");
+    request.is_new_game = data.at("is_new_game");
+    request.weak = data.value("weak", false);
+    for(const json& move : data.at("valid_moves")) {
+        int col = move.get<int>();
+        if(col < 0 || col >= Position::WIDTH) throw std::runtime_error("invalid column in valid_moves");
+        if(request.first_valid_move < 0) request.first_valid_move = col;
+        request.valid_mask |= 1u << col;
     }
-    std::cout << " 1 2 3 4 5 6 7" << std::endl;
+    return request;
 }
 
 // Đăng ký nước đi của đối thủ
-void register_opponent_move(const std::vector<std::vector<int>>& current_board) {
+// The position is rebuilt from the board, the previous board is only used to track the move sequence.
+// Returns false if the game is already over.
+bool register_opponent_move(const Board& current_board, int current_player) {
     // Game over? Reset everything.
-    if(is_game_over(current_board)) {
-        std::cout << "Opponent wins. Game over detected. Resetting state." << std::endl;
+    if(current_board.isGameOver()) {
+        logger.debug("game_over", "winner=opponent");
         reset_state();
-        return;
+        return false;
     }
 
-    int height = current_board.size();
-    int width = current_board[0].size();
-
-    // Find the column where a new piece was added
-    for(int col = 0; col < width; col++) {
-        for(int row = 0; row < height; row++) {
-            if(previous_board[row][col] != current_board[row][col]) {
-                // There is a difference — new disc dropped
-                if(current_board[row][col] != 0 && previous_board[row][col] == 0) {
-                    position.playCol(col);
-                    move_sequence += std::to_string(col + 1);
-                    // Deep copy current_board to previous_board
-                    previous_board = std::vector<std::vector<int>>(current_board);
-                    return;
-                }
-            }
+    const uint64_t previous_mask = previous_board.mask();
+    const uint64_t added = current_board.mask() & ~previous_mask;
+    const int opponent = 3 - current_player;
+    if(added && !(added & (added - 1)) && (current_board.stones[opponent - 1] & added) &&
+       (current_board.mask() & previous_mask) == previous_mask) {
+        // Exactly one new opponent disc on top of the known board
+        for(int col = 0; col < Position::WIDTH; col++) {
+            if(added & Position::column_mask(col)) move_sequence += char('1' + col);
         }
     }
+    else if(!(current_board == previous_board)) {
+        // Board does not follow from the known one (missed request, other client...): restart the sequence
+        logger.debug("resync", "stones=%d", current_board.count());
+        move_sequence.clear();
+    }
+
+    position = current_board.toPosition(current_player);
+    previous_board = current_board;
+    return true;
+}
+
+// Phân tích vị trí với một solver của pool, ghi lại thống kê
+// Returns the number of explored nodes.
+unsigned long long solve_position(const Position& P, int scores[Position::WIDTH], bool weak, int guess) {
+    // Nhường CPU: tạm dừng pondering trong lúc tìm kiếm thật
+    struct PonderPause {
+        PonderPause() { ponderer.beginSearch(); }
+        ~PonderPause() { ponderer.endSearch(); }
+    } pause;
+    SolverPool::Lease solver = solvers.acquire();
+    unsigned long long nodes_before = solver->getNodeCount();
+    unsigned long long book_hits_before = solver->getBookHitCount();
+    unsigned long long probes_before = solver->getTableProbeCount();
+    unsigned long long local_hits_before = solver->getLocalHitCount();
+    unsigned long long shared_hits_before = solver->getSharedHitCount();
+    auto solve_start = std::chrono::steady_clock::now();
+    solver->analyze(P, scores, weak, guess);
+    std::chrono::duration<double> solve_time = std::chrono::steady_clock::now() - solve_start;
+    unsigned long long nodes = solver->getNodeCount() - nodes_before;
+    solve_duration.observe(solve_time.count());
+    nodes_searched_total.inc(nodes);
+    book_hits_total.inc(solver->getBookHitCount() - book_hits_before);
+    tt_probes_total.inc(solver->getTableProbeCount() - probes_before);
+    tt_local_hits_total.inc(solver->getLocalHitCount() - local_hits_before);
+    tt_shared_hits_total.inc(solver->getSharedHitCount() - shared_hits_before);
+    if(solve_time.count() > 0) nodes_per_second.set(nodes / solve_time.count());
+    return nodes;
+}
 
-    // If no move detected (possibly a duplicate request), just update snapshot
-    previous_board = std::vector<std::vector<int>>(current_board);
+// Như solve_position, nhưng các request đồng thời cho cùng một vị trí (hoặc vị trí đối xứng)
+// chờ chung một lần tìm kiếm. Returns 0 nodes when the result was shared.
+// Move requests analyze under game_mutex, one at a time: they never share a search with each
+// other, only with batch or binary analyses of the same position.
+// guess: điểm dự đoán của P (xem Solver::solve), chỉ ảnh hưởng tốc độ.
+unsigned long long analyze_position(const Position& P, int scores[Position::WIDTH], bool weak = false,
+                                    int guess = Solver::NO_GUESS) {
+    uint64_t key = P.key(), mirror_key = P.mirrorKey();
+    bool mirrored = mirror_key < key;
+    uint64_t flight_key = std::min(key, mirror_key) | (weak ? UINT64_C(1) << 63 : 0);
+
+    unsigned long long nodes = 0;
+    int canonical[Position::WIDTH];
+    analyses.run(flight_key, canonical, [&](int* out) {
+        nodes = solve_position(P, out, weak, guess);
+        if(mirrored) std::reverse(out, out + Position::WIDTH);
+    });
+    for(int col = 0; col < Position::WIDTH; col++) {
+        scores[col] = canonical[mirrored ? Position::WIDTH - 1 - col : col];
+    }
+    return nodes;
 }
 
 // Tìm nước đi tối ưu
-int getBestMove(int current_player, const std::vector<int>& valid_moves) {
+// weak: chỉ phân biệt thắng/hòa/thua, nhanh hơn nhiều với các thế cờ khó
+int getBestMove(int current_player, unsigned int valid_mask, bool weak = false) {
     auto start = std::chrono::high_resolution_clock::now();
     
-    std::cout << "\nAnalyzing position..." << std::endl;
-    std::cout << "Current sequence: " << move_sequence << std::endl;
-    
-    // Phân tích tất cả các nước đi
-    std::vector<int> scores = solver.analyze(position);
+    logger.debug("analyze", "sequence=%s", move_sequence.c_str());
 
-    // In ra điểm số của từng nước đi
-    std::cout << "\nScores: ";
-    for (int i = 0; i < Position::WIDTH; i++) {
-        std::cout << scores[i] << " ";
+    // Một tuổi mới cho bảng: các vị trí của ván cũ không được đọc lại sẽ bị thay thế trước
+    solvers.newSearch();
+
+    // Đối thủ đi đúng như dự kiến: đặt lại phần còn lại của diễn biến vào bảng để tìm nó trước
+    if(pv_length > 2 && position.key() == pv_expected.key()) {
+        solvers.seedLine(position, principal_variation + 2, pv_length - 2);
     }
-    std::cout << std::endl;
+    pv_length = 0;
 
-    // Tìm điểm số cao nhất trong các nước đi hợp lệ
-    int best_score = scores[valid_moves[0]];
-    for(int move : valid_moves) {
-        if(scores[move] > best_score) {
-            best_score = scores[move];
-        }
+    // Bỏ các cột đã đầy: analyze cho chúng điểm INVALID_MOVE, cũng là giá trị khởi đầu của best_score
+    for(int col = 0; col < Position::WIDTH; col++) {
+        if(!position.canPlay(col)) valid_mask &= ~(1u << col);
     }
 
-    // Tìm tất cả các cột có điểm bằng điểm cao nhất
-    std::vector<int> best_moves;
-    for(int move : valid_moves) {
-        if(scores[move] == best_score) {
-            best_moves.push_back(move);
+    int best_moves[Position::WIDTH];
+    int nb_best_moves = 0;
+    int best_score = 0;
+    bool exact_score = true; // best_score is the exact score of the position
+    unsigned long long nodes = 0;
+
+    // Nước đi bị ép buộc (thắng ngay, chặn bắt buộc, thua chắc): không cần tìm kiếm
+    TacticalMoves tactical = tacticalMoves(position);
+    int table_move, table_score;
+
+    if(strategy.get(position, table_move, table_score) && (valid_mask >> table_move & 1)) {
+        // Ván của người đi trước: tra bảng, luôn cùng một nước để ở lại trong bảng
+        strategy_hits_total.inc();
+        best_moves[nb_best_moves++] = table_move;
+        best_score = table_score;
+        logger.debug("strategy", "col=%d score=%d", table_move, table_score);
+    } else if(tactical.columns & valid_mask) {
+        tactical_hits_total.inc();
+        for(int move = 0; move < Position::WIDTH; move++) {
+            if((tactical.columns & valid_mask) >> move & 1) best_moves[nb_best_moves++] = move;
         }
+        best_score = tactical.score;
+        exact_score = tactical.exact;
+        logger.debug("tactical", "columns=%u exact=%d score=%d", tactical.columns, tactical.exact, tactical.score);
+    } else {
+        // Phân tích tất cả các nước đi
+        int scores[Position::WIDTH];
+        if(ponderer.lookup(position, scores)) {
+            ponder_hits_total.inc();
+            logger.debug("ponder_hit");
+        } else {
+            nodes = analyze_position(position, scores, weak, weak ? Solver::NO_GUESS : previous_score);
+        }
+        exact_score = !weak;
+
+        // In ra điểm số của từng nước đi
+        logger.debug("scores", "scores=%d,%d,%d,%d,%d,%d,%d", scores[0], scores[1], scores[2], scores[3], scores[4], scores[5], scores[6]);
+
+        // Tìm điểm số cao nhất trong các nước đi hợp lệ
+        best_score = Solver::INVALID_MOVE;
+        for(int move = 0; move < Position::WIDTH; move++) {
+            if((valid_mask >> move & 1) && scores[move] > best_score) {
+                best_score = scores[move];
+            }
+        }
+
+        // Tìm tất cả các cột có điểm bằng điểm cao nhất
+        for(int move = 0; move < Position::WIDTH; move++) {
+            if((valid_mask >> move & 1) && scores[move] == best_score) {
+                best_moves[nb_best_moves++] = move;
+            }
+        }
+        if(nb_best_moves == 0) throw std::runtime_error("no playable valid move");
     }
 
     // Random chọn một trong các cột tốt nhất
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(0, best_moves.size() - 1);
+    static std::mt19937 gen(random_seed()); // game_mutex held: one sequence whatever the serving thread
+    std::uniform_int_distribution<> dis(0, nb_best_moves - 1);
     int best_col = best_moves[dis(gen)];
 
-    // Cập nhật trạng thái
-    position.playCol(best_col);
-    move_sequence += std::to_string(best_col + 1);
-
     // Cập nhật previous_board với nước đi của AI
-    for(int row = previous_board.size() - 1; row >= 0; row--) {
-        if(previous_board[row][best_col] == 0) {
-            previous_board[row][best_col] = current_player;
-            break;
-        }
-    }
+    previous_board.play(best_col, current_player);
 
-    // Game over? Reset everything.
-    if(is_game_over(previous_board)) {
-        std::cout << "I win. Game over detected. Resetting state." << std::endl;
+    // Game over? Reset everything, the move is still returned.
+    if(previous_board.isGameOver()) {
+        logger.debug("game_over", "winner=self");
         reset_state();
-        return -1;
+        principal_variation[0] = best_col;
+        pv_length = 1;
+        return best_col;
     }
 
+    // Cập nhật trạng thái
+    position.playCol(best_col);
+    move_sequence += char('1' + best_col);
+    active_sessions.set(1);
+    previous_score = exact_score ? best_score : Solver::NO_GUESS;
+    principal_variation[0] = best_col;
+    pv_length = 1 + solvers.principalVariation(position, principal_variation + 1, Position::WIDTH * Position::HEIGHT - 1 - position.nbMoves());
+    if(pv_length > 1) {
+        pv_expected = position;
+        pv_expected.playCol(principal_variation[1]);
+    }
+    ponderer.ponder(position);
+
     auto end = std::chrono::high_resolution_clock::now();
     auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-    std::cout << "Analysis took " << duration.count() << "ms" << std::endl;
-    std::cout << "Selected move: " << best_col << " with score: " << scores[best_col] << std::endl;
-    std::cout << "Number of equally good moves: " << best_moves.size() << std::endl;
+    logger.debug("move_selected", "col=%d score=%d equal_moves=%d analysis_ms=%lld nodes=%llu pv_length=%d",
+                 best_col, best_score, nb_best_moves, (long long)duration.count(), nodes, pv_length);
 
     return best_col;
 }
 
+// Xử lý body của /api/connect4-move, dùng chung cho httplib và AsyncServer
+// Returns the HTTP status, response receives the JSON body.
+int handle_move_request(const char* body, size_t size, std::string& response) {
+    requests_total.inc();
+    inflight_requests.inc();
+    auto request_start = std::chrono::steady_clock::now();
+    int status = 200;
+
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+
+        MoveRequest request;
+        MoveRequestParser parser(body, body + size);
+        if(!parser.parse(request)) {
+            json_fallback_total.inc();
+            request = decode_move_request(json::parse(body, body + size));
+        }
+        if(const char* error = request.validate()) throw std::runtime_error(error);
+
+        logger.debug("request", "current_player=%d valid_moves=%#x is_new_game=%s",
+                     request.current_player, request.valid_mask, request.is_new_game ? "true" : "false");
+        printBoard(request.board);
+
+        std::lock_guard<std::mutex> lock(game_mutex);
+
+        // Reset state nếu là game mới
+        if (request.is_new_game) {
+            logger.debug("new_game");
+            reset_state();
+        }
+
+        // Đăng ký nước đi của đối thủ
+        // Nếu game over, trả về nước đi đầu tiên
+        int selected_move = request.first_valid_move;
+        int length = 0;
+        if(register_opponent_move(request.board, request.current_player)) {
+            // Lấy nước đi tốt nhất
+            selected_move = getBestMove(request.current_player, request.valid_mask, request.weak);
+            length = pv_length;
+        }
+
+        char buffer[32 + 2 * Position::WIDTH * Position::HEIGHT];
+        response.assign(buffer, writeMoveResponse(buffer, sizeof(buffer), selected_move, principal_variation, length));
+
+        auto end = std::chrono::high_resolution_clock::now();
+        auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+        logger.debug("request_done", "move=%d total_ms=%lld", selected_move, (long long)duration.count());
+
+    } catch (const std::exception& e) {
+        logger.warn("request_error", "error=\"%s\"", e.what());
+        request_errors_total.inc();
+        json error = {{"error", e.what()}};
+        status = 400;
+        response = error.dump();
+    }
+
+    std::chrono::duration<double> request_time = std::chrono::steady_clock::now() - request_start;
+    request_duration.observe(request_time.count());
+    inflight_requests.dec();
+    return status;
+}
+
+// Lô vị trí của /api/analyze-batch, chia sẻ giữa các luồng phân tích và luồng gửi kết quả
+struct BatchJob {
+    static constexpr size_t MAX_POSITIONS = 10000;
+
+    std::vector<Position> positions;
+    std::vector<std::string> errors; // lỗi đọc vị trí, rỗng nếu hợp lệ
+    bool weak = false;
+
+    std::atomic<size_t> next{0};         // next position to analyze
+    std::atomic<bool> cancelled{false};  // client went away
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::string> lines;       // NDJSON lines not yet sent
+    size_t sent = 0;
+};
+
+// Một vị trí là chuỗi nước đi "4453", hoặc {"moves": "4453"}, hoặc {"board": [[...]], "current_player": 1}
+Position decode_batch_position(const json& item) {
+    Position P;
+    const json* moves = item.is_string() ? &item : item.is_object() && item.contains("moves") ? &item["moves"] : nullptr;
+    if(moves) {
+        std::string sequence = moves->get<std::string>();
+        if(P.play(sequence) != sequence.size()) throw std::runtime_error("invalid move sequence");
+        return P;
+    }
+    if(!item.is_object()) throw std::runtime_error("position must be a move sequence or an object");
+    Board board = decode_board(item.at("board"));
+    int current_player = item.at("current_player");
+    if(!board.isValid()) throw std::runtime_error("floating stones on board");
+    if(current_player != 1 && current_player != 2) throw std::runtime_error("current_player must be 1 or 2");
+    if(board.isGameOver()) throw std::runtime_error("game over");
+    return board.toPosition(current_player);
+}
+
+std::shared_ptr<BatchJob> decode_batch(const json& data) {
+    const json& positions = data.at("positions");
+    if(!positions.is_array()) throw std::runtime_error("positions must be an array");
+    if(positions.size() > BatchJob::MAX_POSITIONS) throw std::runtime_error("too many positions");
+    auto job = std::make_shared<BatchJob>();
+    job->weak = data.value("weak", false);
+    job->positions.resize(positions.size());
+    job->errors.resize(positions.size());
+    for(size_t i = 0; i < positions.size(); i++) {
+        try {
+            job->positions[i] = decode_batch_position(positions[i]);
+        } catch (const std::exception& e) {
+            job->errors[i] = e.what();
+        }
+    }
+    return job;
+}
+
+// Phân tích vị trí thứ i của lô và đưa dòng kết quả cho luồng gửi
+void analyze_batch_item(BatchJob& job, size_t i) {
+    json line = {{"index", i}};
+    if(!job.errors[i].empty()) {
+        line["error"] = job.errors[i];
+    } else {
+        int scores[Position::WIDTH];
+        line["nodes"] = analyze_position(job.positions[i], scores, job.weak);
+        json& out = line["scores"] = json::array();
+        for(int score : scores) {
+            if(score == Solver::INVALID_MOVE) out.push_back(nullptr);
+            else out.push_back(score);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(job.mutex);
+        job.lines.push_back(line.dump() + "\n");
+    }
+    job.ready.notify_one();
+}
+
+// Số luồng cố định do server sở hữu chạy mọi lô; mỗi vị trí mượn một solver của pool (TT dùng chung).
+// Các lô chạy song song lần lượt nhận từng vị trí, lô đã hủy hoặc đã phát hết thì bị bỏ khỏi hàng đợi.
+class BatchWorkers {
+public:
+    ~BatchWorkers() {
+        stop();
+    }
+
+    void start(size_t count) {
+        for(size_t i = 0; i < count; i++) threads.emplace_back(&BatchWorkers::work, this);
+    }
+
+    void submit(const std::shared_ptr<BatchJob>& job) {
+        if(job->positions.empty()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back(job);
+        }
+        ready.notify_all();
+    }
+
+    // Dừng sau vị trí đang phân tích, các lô còn lại bị bỏ
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        ready.notify_all();
+        for(auto& t : threads) t.join();
+        threads.clear();
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::shared_ptr<BatchJob>> jobs; // lô còn vị trí chưa phát
+    bool stopping = false;
+    std::vector<std::thread> threads;
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while(true) {
+            ready.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if(stopping) return;
+            std::shared_ptr<BatchJob> job = std::move(jobs.front());
+            jobs.pop_front();
+            if(job->cancelled) continue;
+            size_t i = job->next++;
+            if(job->next < job->positions.size()) jobs.push_back(job); // vòng tròn giữa các lô
+            lock.unlock();
+            analyze_batch_item(*job, i);
+            lock.lock();
+        }
+    }
+};
+BatchWorkers batch_workers;
+
+// Gửi các kết quả đã xong theo thứ tự hoàn thành, kết thúc khi đủ mọi vị trí
+bool write_batch_results(BatchJob& job, httplib::DataSink& sink) {
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.ready.wait(lock, [&job] { return !job.lines.empty() || job.sent == job.positions.size(); });
+    while(!job.lines.empty()) {
+        std::string line = std::move(job.lines.front());
+        job.lines.pop_front();
+        lock.unlock();
+        if(!sink.write(line.data(), line.size())) return false;
+        lock.lock();
+        job.sent++;
+    }
+    if(job.sent == job.positions.size()) sink.done();
+    return true;
+}
+
 int main() {
-    std::cout << "Initializing solver..." << std::endl;
-    
-    std::cout << "Loading opening book..." << std::endl;
-    solver.loadBook("7x6.book");
+    // LOG_LEVEL=debug|info|warn|error|off, warn keeps the request path silent in production
+    logger.setLevel(Logger::parseLevel(std::getenv("LOG_LEVEL"), Logger::Info));
+
+    logger.info("startup", "book=7x6.book tt_huge_pages=%d tt_interleaved=%d",
+                solvers.getTable().hugePages(), solvers.getTable().isInterleaved());
+    solvers.loadBook("7x6.book");
+
+    // Sách thắng/hòa/thua (bookconv -w), dùng thêm cho các tìm kiếm weak
+    if(const char* wdl_book = std::getenv("WDL_BOOK")) {
+        logger.info("wdl_book", "file=%s", wdl_book);
+        solvers.loadBook(wdl_book);
+    }
+
+    // Bảng tàn cuộc (công cụ endgame): tra thay vì tìm kiếm các thế cờ muộn
+    if(const char* endgame_table = std::getenv("ENDGAME_TABLE")) {
+        logger.info("endgame_table", "file=%s", endgame_table);
+        solvers.loadBook(endgame_table);
+    }
+
+    const char* strategy_file = std::getenv("STRATEGY_FILE");
+    if(strategy.load(strategy_file ? strategy_file : "7x6.strategy")) {
+        logger.info("strategy_loaded", "positions=%llu", (unsigned long long)strategy.size());
+    }
 
-    // Khởi tạo previous_board
-    init_previous_board();
+    // PONDER=1: dùng thời gian chờ đối thủ để tìm trước các nước trả lời có khả năng nhất
+    if(const char* ponder = std::getenv("PONDER")) {
+        if(std::atoi(ponder)) {
+            logger.info("pondering");
+            ponderer.start(solvers.createSolver());
+        }
+    }
+
+    // Chuỗi nước đi không bao giờ dài quá số ô, tránh cấp phát lại trong lúc xử lý request
+    move_sequence.reserve(Position::WIDTH * Position::HEIGHT);
+
+    batch_workers.start(solvers.size());
 
     httplib::Server svr;
+    // httplib ghi header và body riêng: không có TCP_NODELAY, mỗi câu trả lời trên kết nối
+    // keep-alive chờ ACK trễ của client (~40ms) trước khi gửi body
+    svr.set_tcp_nodelay(true);
 
     // Đọc port từ biến môi trường hoặc dùng default
     const char* port_str = std::getenv("PORT");
-    int port = port_str ? std::stoi(port_str) : 8080;
+    uint16_t port = 8080;
+    if(port_str && !AsyncServer::parsePort(port_str, port)) {
+        logger.error("invalid_port", "port=%s", port_str);
+        return 1;
+    }
 
     svr.Options(".*", [](const httplib::Request& req, httplib::Response& res) {
         res.set_header("Access-Control-Allow-Origin", "*");
@@ -251,53 +656,22 @@ int main() {
     // API chính để lấy nước đi
     svr.Post("/api/connect4-move", [](const httplib::Request& req, httplib::Response& res) {
         res.set_header("Access-Control-Allow-Origin", "*");
-        
-        try {
-            auto start = std::chrono::high_resolution_clock::now();
-
-            json data = json::parse(req.body);
-            std::vector<std::vector<int>> board = data["board"];
-            int current_player = data["current_player"];
-            std::vector<int> valid_moves = data["valid_moves"];
-            bool is_new_game = data["is_new_game"];
-
-            if (valid_moves.empty()) throw std::runtime_error("no valid moves");
-
-            std::cout << "\nReceived request with:" << std::endl;
-            std::cout << "Current player: " << current_player << std::endl;
-            std::cout << "Valid moves: ";
-            for(int move : valid_moves) std::cout << move << " ";
-            std::cout << std::endl;
-            std::cout << "Is new game: " << (is_new_game ? "true" : "false") << std::endl;
-            printBoard(board);
-
-            // Reset state nếu là game mới
-            if (is_new_game) {
-                std::cout << "New game detected. Resetting state." << std::endl;
-                reset_state();
-            }
-
-            // Đăng ký nước đi của đối thủ
-            register_opponent_move(board);
-
-            // Lấy nước đi tốt nhất
-            int selected_move = getBestMove(current_player, valid_moves);
-
-            // Nếu game over, trả về nước đi đầu tiên
-            if(selected_move == -1) {
-                selected_move = valid_moves[0];
-            }
-
-            json response = {{"move", selected_move}};
-            res.set_content(response.dump(), "application/json");
-
-            auto end = std::chrono::high_resolution_clock::now();
-            auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-            std::cout << "\nTotal request processed in " << duration.count() << "ms" << std::endl;
-            std::cout << "--------------------\n" << std::endl;
+        std::string response;
+        res.status = handle_move_request(req.body.data(), req.body.size(), response);
+        res.set_content(response, "application/json");
+    });
 
+    // Phân tích nhiều vị trí trong một request
+    svr.Post("/api/analyze-batch", [](const httplib::Request& req, httplib::Response& res) {
+        res.set_header("Access-Control-Allow-Origin", "*");
+        try {
+            std::shared_ptr<BatchJob> job = decode_batch(json::parse(req.body));
+            batch_workers.submit(job);
+            res.set_chunked_content_provider("application/x-ndjson",
+                [job](size_t, httplib::DataSink& sink) { return write_batch_results(*job, sink); },
+                [job](bool) { job->cancelled = true; });
         } catch (const std::exception& e) {
-            std::cerr << "Error: " << e.what() << std::endl;
+            logger.warn("batch_error", "error=\"%s\"", e.what());
             json error = {{"error", e.what()}};
             res.status = 400;
             res.set_content(error.dump(), "application/json");
@@ -314,13 +688,68 @@ int main() {
         res.set_content(response.dump(), "application/json");
     });
 
+    // Prometheus scrape endpoint
+    svr.Get("/metrics", [](const httplib::Request&, httplib::Response& res) {
+        res.set_content(render_metrics(), "text/plain; version=0.0.4");
+    });
+
     // Reset ván
     svr.Post("/api/reset", [](const httplib::Request& req, httplib::Response& res) {
+        std::lock_guard<std::mutex> lock(game_mutex);
         reset_state();
         res.set_content("{\"status\": \"reset done\"}", "application/json");
     });
 
-    std::cout << "Server running on port " << port << "..." << std::endl;
+    // Front end bất đồng bộ cho nhiều kết nối keep-alive: ASYNC_PORT=8081
+    // và giao thức nhị phân cho client nội bộ: BINARY_LISTEN=9090 hoặc BINARY_LISTEN=unix:/path
+    // Nước đi và reset chờ game_mutex: chạy tuần tự trên luồng riêng để không giữ các worker của lệnh nhị phân
+    async_server.route("POST", "/api/connect4-move", [](const char* body, size_t size) {
+        AsyncServer::HttpResponse res;
+        res.status = handle_move_request(body, size, res.body);
+        return res;
+    }, AsyncServer::SERIAL);
+    async_server.route("POST", "/api/reset", [](const char*, size_t) {
+        std::lock_guard<std::mutex> lock(game_mutex);
+        reset_state();
+        AsyncServer::HttpResponse res;
+        res.body = "{\"status\": \"reset done\"}";
+        return res;
+    }, AsyncServer::SERIAL);
+    async_server.route("GET", "/api/test", [](const char*, size_t) {
+        AsyncServer::HttpResponse res;
+        res.body = "{\"message\":\"Server is running\",\"status\":\"ok\"}";
+        return res;
+    }, AsyncServer::INLINE);
+    async_server.route("GET", "/metrics", [](const char*, size_t) {
+        AsyncServer::HttpResponse res;
+        res.content_type = "text/plain; version=0.0.4";
+        res.body = render_metrics();
+        return res;
+    }, AsyncServer::INLINE);
+    async_server.setBinaryHandler([](const Position& P, bool weak, int* scores) {
+        binary_requests_total.inc();
+        analyze_position(P, scores, weak);
+    }, Solver::INVALID_MOVE);
+
+    bool async_enabled = false;
+    if(const char* async_port = std::getenv("ASYNC_PORT")) {
+        async_enabled = async_server.listen(async_port, AsyncServer::HTTP);
+        if(async_enabled) logger.info("async_listening", "port=%s", async_port);
+        else logger.error("async_listen_failed", "port=%s error=\"%s\"", async_port, std::strerror(errno));
+    }
+    if(const char* binary_address = std::getenv("BINARY_LISTEN")) {
+        bool ok = async_server.listen(binary_address, AsyncServer::BINARY);
+        if(ok) logger.info("binary_listening", "address=%s", binary_address);
+        else logger.error("binary_listen_failed", "address=%s error=\"%s\"", binary_address, std::strerror(errno));
+        async_enabled = async_enabled || ok;
+    }
+    std::thread async_thread;
+    if(async_enabled) async_thread = std::thread([] { async_server.run(); });
+
+    logger.info("listening", "port=%d", port);
     svr.listen("0.0.0.0", port);
+    async_server.stop();
+    if(async_thread.joinable()) async_thread.join();
+    batch_workers.stop();
     return 0;
 }
\ No newline at end of file
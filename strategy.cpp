@@ -0,0 +1,85 @@
+#include "Solver.h"
+#include "StrategyTable.h"
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+using namespace GameSolver::Connect4;
+using namespace std;
+
+/**
+ * Build a StrategyTable: the best move of the first player in every position
+ * reachable when it follows its best moves and the opponent plays anything.
+ *
+ * usage: strategy [-d max_moves] [-b book] [-r root_moves] output_file
+ *
+ * Positions are expanded depth first from the empty board, or from the position
+ * reached by root_moves (an even number of moves, e.g. to split the work per opening).
+ * At each first player position the best move is chosen among the equal best scores
+ * by preferring the center columns, then every reply of the opponent is expanded.
+ * Positions with more than max_moves stones (at most StrategyTable::MAX_MOVES) are
+ * left to the live search.
+ */
+
+static Solver solver;
+static unordered_set<uint64_t> visited;
+static vector<StrategyTable::Entry> entries;
+static int max_moves = StrategyTable::MAX_MOVES;
+static const int column_order[Position::WIDTH] = {3, 2, 4, 1, 5, 0, 6};
+
+// P: position with the first player to move
+void expand(const Position &P) {
+  if(P.nbMoves() > max_moves || !visited.insert(P.key3()).second) return;
+
+  int scores[Position::WIDTH];
+  solver.analyze(P, scores);
+  int best = -1;
+  for(int i = 0; i < Position::WIDTH; i++) {
+    int col = column_order[i];
+    if(scores[col] != Solver::INVALID_MOVE && (best < 0 || scores[col] > scores[best])) best = col;
+  }
+  if(best < 0) return; // full board
+  entries.push_back(StrategyTable::makeEntry(P, best, scores[best]));
+  if(entries.size() % 100000 == 0) cerr << entries.size() << " positions, depth " << P.nbMoves() << endl;
+
+  if(P.isWinningMove(best)) return;
+  Position P2(P);
+  P2.playCol(best);
+  if(P2.nbMoves() == Position::WIDTH * Position::HEIGHT) return;
+  for(int col = 0; col < Position::WIDTH; col++) {
+    if(!P2.canPlay(col) || P2.isWinningMove(col)) continue; // the opponent winning ends the game
+    Position P3(P2);
+    P3.playCol(col);
+    expand(P3);
+  }
+}
+
+int main(int argc, char **argv) {
+  string book = "7x6.book";
+  string output;
+  string root_moves;
+  for(int i = 1; i < argc; i++) {
+    string arg = argv[i];
+    if(arg == "-d" && i + 1 < argc) max_moves = stoi(argv[++i]);
+    else if(arg == "-b" && i + 1 < argc) book = argv[++i];
+    else if(arg == "-r" && i + 1 < argc) root_moves = argv[++i];
+    else output = arg;
+  }
+  Position root;
+  if(output.empty() || max_moves < 0 || max_moves > StrategyTable::MAX_MOVES ||
+     root.play(root_moves) != root_moves.size() || root.nbMoves() % 2) {
+    cerr << "usage: " << argv[0] << " [-d max_moves (<= " << StrategyTable::MAX_MOVES << ")] [-b book] [-r root_moves] output_file" << endl;
+    return 1;
+  }
+
+  solver.loadBook(book);
+  expand(root);
+  cerr << entries.size() << " positions, " << solver.getNodeCount() << " nodes searched" << endl;
+
+  if(!StrategyTable::write(output, entries, max_moves)) {
+    cerr << "Error writing " << output << endl;
+    return 1;
+  }
+  return 0;
+}